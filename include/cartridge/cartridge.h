@@ -32,11 +32,21 @@ typedef struct {
 struct GB_cartridge_s {
 	GB_header_t 				*header;
 	GB_mbc_t					*mbc;
+	const BYTE 					*rom; 					// Shared read-only mapping of the ROM file
+	size_t 						rom_size;
 };
 
 void 			GB_print_header(GB_header_t *header);
 
-GB_cartridge_t* GB_cartridge_create(const char *path);
+/// Battery-backed RAM persists in the file at save_path, it stays in memory when NULL or when the file is in use
+GB_cartridge_t* GB_cartridge_create(const char *path, const char *save_path);
 void 			GB_cartridge_destroy(GB_cartridge_t *cartridge);
 
+/// ROM path with its extension replaced by .sav, to be freed. NULL when out of memory
+char* 			GB_cartridge_save_path(const char *rom_path);
+
+/// Hands battery-backed RAM written since the last call over to the system without waiting for the disk.
+/// Destroy writes it synchronously
+void 			GB_cartridge_flush(GB_cartridge_t *cartridge);
+
 #endif
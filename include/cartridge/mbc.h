@@ -4,12 +4,20 @@
 #include "defs.h"
 #include "cartridge/cartridge.h"
 
-#include <stdio.h>
+#include <stddef.h> // size_t
 
-GB_mbc_t*   GB_mbc_create(GB_header_t *header, FILE *rom_fp, long file_size);
+/// rom is borrowed, it must outlive the MBC. Battery-backed RAM is mapped from save_path unless NULL
+GB_mbc_t*   GB_mbc_create(GB_header_t *header, const BYTE *rom, size_t rom_size, const char *save_path);
 void        GB_mbc_destroy(GB_mbc_t *mbc);
 
 BYTE        GB_mbc_read(GB_mbc_t *mbc, WORD addr);
 void        GB_mbc_write(GB_mbc_t *mbc, WORD addr, BYTE data);
+/// Writes the RAM modified since the last flush to the save file, without waiting for the disk
+void        GB_mbc_flush(GB_mbc_t *mbc);
+/// ROM bank currently mapped at addr (0000-7FFF)
+int         GB_mbc_rom_bank(GB_mbc_t *mbc, WORD addr);
+/// Memory mapped at the area holding addr (0000-3FFF, 4000-7FFF or A000-BFFF), NULL when it cannot be read directly.
+/// Changes on every write to 0000-7FFF
+const BYTE* GB_mbc_base(GB_mbc_t *mbc, WORD addr);
 
 #endif
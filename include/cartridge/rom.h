@@ -0,0 +1,18 @@
+#ifndef GB_ROM_H_
+#define GB_ROM_H_
+
+#include "type.h"
+
+#include <stddef.h> // size_t
+
+/**
+ * Process-wide ROM registry: every instance loading the same file shares one read-only mapping,
+ * refcounted and unmapped along with its last user.
+*/
+
+/// Maps the ROM file at path and stores its size in *size. NULL on failure
+const BYTE*     GB_rom_map(const char *path, size_t *size);
+/// Drops a reference taken by GB_rom_map
+void            GB_rom_unmap(const BYTE *rom);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef GB_SAVE_H_
+#define GB_SAVE_H_
+
+#include "type.h"
+
+#include <stddef.h> // size_t
+
+/**
+ * Battery-backed RAM mapped straight from its .sav file (MAP_SHARED).
+ * Writes mark their page dirty, GB_save_flush() then syncs only those pages to disk.
+ * The file is locked (flock) for as long as it is mapped: a single instance at a time gets to use it.
+*/
+
+typedef struct {
+    BYTE        *data;              // Mapped external RAM
+    size_t      size;
+    int         fd;
+    int         page_shift;         // log2 of the system page size
+    BYTE        *dirty;             // One bit per page
+} GB_save_t;
+
+#define GB_SAVE_PAGE(save, offset)              ( (offset) >> (save)->page_shift )
+#define GB_SAVE_MARK_DIRTY(save, offset)        ( (save)->dirty[GB_SAVE_PAGE(save, offset) >> 3] |= (BYTE)( 1 << (GB_SAVE_PAGE(save, offset) & 7) ) )
+
+/// Maps size bytes of the file at path, creating or growing it as needed. NULL on failure or when already locked
+GB_save_t*  GB_save_create(const char *path, size_t size);
+/// Flushes every dirty page, waiting for the disk, then unmaps the file
+void        GB_save_destroy(GB_save_t *save);
+
+/// Writes the dirty pages back to the file, only scheduling the writes unless wait is set. Returns 0 on success
+int         GB_save_flush(GB_save_t *save, int wait);
+
+#endif
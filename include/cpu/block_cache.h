@@ -0,0 +1,38 @@
+#ifndef GB_BLOCK_CACHE_H_
+#define GB_BLOCK_CACHE_H_
+
+#include "defs.h"
+#include "type.h"
+
+#define GB_BLOCK_MAX_INSTRS     (16)
+
+typedef struct {
+    WORD                pc;                         // Address of the opcode
+    BYTE                opcode;
+    BYTE                operands[2];                // Immediate bytes (CB opcode for $CB)
+    BYTE                length;                     // Instruction length in bytes
+    BYTE                cycles;                     // Cost in M-cycles, branch not taken
+} GB_decoded_instr_t;
+
+typedef struct {
+    DWORD               key;                        // Mapped ROM bank << 16 | start address
+    int                 is_valid;
+    int                 instr_count;
+    int                 cycles;                     // Sum of every instruction cost
+    WORD                end;                        // Address following the last instruction
+    int                 idle_loop_cycles;           // M-cycles of one iteration when the block is an idle loop, 0 otherwise
+    GB_decoded_instr_t  instrs[GB_BLOCK_MAX_INSTRS];
+} GB_block_t;
+
+typedef struct GB_block_cache_s GB_block_cache_t;
+
+GB_block_cache_t*   GB_block_cache_create();
+void                GB_block_cache_destroy(GB_block_cache_t *cache);
+
+/// Returns the block starting at pc, decoding it on miss. NULL when pc lies in an uncached area (VRAM, EXT RAM, IO...)
+GB_block_t*         GB_block_cache_lookup(GB_gameboy_t *gb, WORD pc);
+
+/// Must see every CPU write: drops the blocks overwritten in WRAM/HRAM and the current block on MBC register writes
+void                GB_block_cache_write_notify(GB_gameboy_t *gb, WORD addr);
+
+#endif
@@ -2,6 +2,8 @@
 #define GB_CPU_H_
 
 #include "cpu/timer.h"
+#include "cpu/block_cache.h"
+#include "cpu/profiler.h"
 #include "type.h"
 #include "defs.h"
 
@@ -14,10 +16,8 @@ typedef union
     } b;
 } CPU_Reg;
 
+/// Register file, accessed through the cpudef.h macros
 typedef struct {
-    WORD                ir;                         // Instruction register
-    WORD                prev_ir;
-
     CPU_Reg             af;                         // Register AF (Accumulator + Flags)
     CPU_Reg             bc;                         // Register BC (B + C)
     CPU_Reg             de;                         // Register DE (D + E)
@@ -26,6 +26,19 @@ typedef struct {
     CPU_Reg             sp;                         // Stack pointer
     CPU_Reg             pc;                         // Program counter
     CPU_Reg             wz;                         // Memory pointer
+} GB_cpu_regs_t;
+
+typedef struct {
+    WORD                ir;                         // Instruction register
+    WORD                prev_ir;
+
+    GB_cpu_regs_t       regs;
+
+    int                 flags_op;                   // Last ALU operation whose flags are not in F yet (see instr.h)
+    BYTE                flags_lhs;
+    BYTE                flags_rhs;
+    BYTE                flags_carry;                // Carry in for ADC/SBC, preserved carry flag for INC/DEC
+    int                 flags_res;
 
     int                 IME;                        // Interrup master enable [write only]
     int                 ei_delay;
@@ -33,11 +46,32 @@ typedef struct {
     int                 is_halted;
     int                 is_stopped;
     uint64_t            t_cycle_counter;
-    GB_timer_t         *timer;
+    GB_timer_t          timer;
 } GB_cpu_t;
 
-GB_cpu_t*   GB_cpu_create();
-void        GB_cpu_destroy(GB_cpu_t *cpu);
+/// Host side of instruction execution: caches only, none of it is machine state
+typedef struct {
+    GB_block_cache_t   *block_cache;
+    GB_block_t         *block;                      // Block being executed, NULL when running from the bus
+    int                 block_pos;                  // Index of the next instruction in block
+    const GB_decoded_instr_t *instr;                // Current instruction if it was served by the block cache
+
+    GB_block_t         *idle_block;                 // Idle loop entered last, see GB_cpu_skip_idle_loop
+    uint64_t            idle_t;                     // t_cycle_counter when entering it
+    uint64_t            idle_next;                  // Earliest component deadline when entering it
+
+#ifdef GB_PROFILER
+    GB_profiler_t      *profiler;                   // Opcode statistics, NULL unless requested
+#endif
+} GB_exec_t;
+
+void        GB_cpu_init(GB_cpu_t *cpu);
+GB_exec_t*  GB_exec_create();
+void        GB_exec_destroy(GB_exec_t *exec);
 void        GB_cpu_run(GB_gameboy_t *gb);
+/// Skips the iterations of an idle loop starting at the current instruction that cannot see any change
+void        GB_cpu_skip_idle_loop(GB_gameboy_t *gb);
+/// Runs up to count instructions, the ones not halted with registers kept in a local copy (see cpu_batch.c)
+void        GB_cpu_run_batch(GB_gameboy_t *gb, int count);
 
 #endif
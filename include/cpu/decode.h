@@ -3,14 +3,119 @@
 
 #include "cpu/instr.h"
 
-#define OP_X    (IR >> 6)
-#define OP_Y    ((IR >> 3)  & 7)
-#define OP_Z    (IR         & 7)
+/**
+ * Every opcode is dispatched to its own handler where OPCODE is a compile-time constant.
+ * Opcode fields, register selection (RY, RZ, RP, ...) and condition codes are thus folded
+ * by the compiler and DECODE() boils down to a single jump through the switch table.
+*/
+#define OP_X    (OPCODE >> 6)
+#define OP_Y    ((OPCODE >> 3)  & 7)
+#define OP_Z    (OPCODE         & 7)
 #define OP_Q    (OP_Y & 1)
 #define OP_P    (OP_Y >> 1)
 
 #define LOG_ERR() do {} while(0)
 
+/*-----------------------OPCODE TABLES-------------------------*/
+
+#define _BYTE_ROW(X, h)                                                                                         \
+    X(0x##h##0) X(0x##h##1) X(0x##h##2) X(0x##h##3) X(0x##h##4) X(0x##h##5) X(0x##h##6) X(0x##h##7)             \
+    X(0x##h##8) X(0x##h##9) X(0x##h##A) X(0x##h##B) X(0x##h##C) X(0x##h##D) X(0x##h##E) X(0x##h##F)
+
+#define FOR_EACH_BYTE(X)                                                                                        \
+    _BYTE_ROW(X, 0) _BYTE_ROW(X, 1) _BYTE_ROW(X, 2) _BYTE_ROW(X, 3)                                             \
+    _BYTE_ROW(X, 4) _BYTE_ROW(X, 5) _BYTE_ROW(X, 6) _BYTE_ROW(X, 7)                                             \
+    _BYTE_ROW(X, 8) _BYTE_ROW(X, 9) _BYTE_ROW(X, A) _BYTE_ROW(X, B)                                             \
+    _BYTE_ROW(X, C) _BYTE_ROW(X, D) _BYTE_ROW(X, E) _BYTE_ROW(X, F)
+
+#define _LD_R_R_ROW(X, h)                                                                                       \
+    X(0x##h##0, LD_R_R)         X(0x##h##1, LD_R_R)         X(0x##h##2, LD_R_R)         X(0x##h##3, LD_R_R)     \
+    X(0x##h##4, LD_R_R)         X(0x##h##5, LD_R_R)         X(0x##h##6, LD_R_R)         X(0x##h##7, LD_R_R)     \
+    X(0x##h##8, LD_R_R)         X(0x##h##9, LD_R_R)         X(0x##h##A, LD_R_R)         X(0x##h##B, LD_R_R)     \
+    X(0x##h##C, LD_R_R)         X(0x##h##D, LD_R_R)         X(0x##h##E, LD_R_R)         X(0x##h##F, LD_R_R)
+
+#define _ALU_R_ROW(X, h)                                                                                        \
+    X(0x##h##0, ALU_R)          X(0x##h##1, ALU_R)          X(0x##h##2, ALU_R)          X(0x##h##3, ALU_R)      \
+    X(0x##h##4, ALU_R)          X(0x##h##5, ALU_R)          X(0x##h##6, ALU_R)          X(0x##h##7, ALU_R)      \
+    X(0x##h##8, ALU_R)          X(0x##h##9, ALU_R)          X(0x##h##A, ALU_R)          X(0x##h##B, ALU_R)      \
+    X(0x##h##C, ALU_R)          X(0x##h##D, ALU_R)          X(0x##h##E, ALU_R)          X(0x##h##F, ALU_R)
+
+/**
+ * Unprefixed opcodes
+ *
+ * Note: Illegal opcodes keep the behaviour of the former X/Y/Z decoder,
+ * $D3, $DB, $E3 and $EB do nothing while $E4, $EC, $F4, $FC and $DD, $ED, $FD decode as CALL
+*/
+#define OPCODE_TABLE(X)                                                                                         \
+    X(0x00, NOP)                X(0x01, LD_RP_NN)           X(0x02, LD_IBC_A)           X(0x03, INC_RP)         \
+    X(0x04, INC_R)              X(0x05, DEC_R)              X(0x06, LD_R_N)             X(0x07, RLCA)           \
+    X(0x08, LD_DNN_SP)          X(0x09, ADD_HL_RP)          X(0x0A, LD_A_IBC)           X(0x0B, DEC_RP)         \
+    X(0x0C, INC_R)              X(0x0D, DEC_R)              X(0x0E, LD_R_N)             X(0x0F, RRCA)           \
+                                                                                                                \
+    X(0x10, STOP)               X(0x11, LD_RP_NN)           X(0x12, LD_IDE_A)           X(0x13, INC_RP)         \
+    X(0x14, INC_R)              X(0x15, DEC_R)              X(0x16, LD_R_N)             X(0x17, RLA)            \
+    X(0x18, JP_DISP)            X(0x19, ADD_HL_RP)          X(0x1A, LD_A_IDE)           X(0x1B, DEC_RP)         \
+    X(0x1C, INC_R)              X(0x1D, DEC_R)              X(0x1E, LD_R_N)             X(0x1F, RRA)            \
+                                                                                                                \
+    X(0x20, JP_CC_DISP)         X(0x21, LD_RP_NN)           X(0x22, LD_IHL_A_INC)       X(0x23, INC_RP)         \
+    X(0x24, INC_R)              X(0x25, DEC_R)              X(0x26, LD_R_N)             X(0x27, DAA)            \
+    X(0x28, JP_CC_DISP)         X(0x29, ADD_HL_RP)          X(0x2A, LD_A_IHL_INC)       X(0x2B, DEC_RP)         \
+    X(0x2C, INC_R)              X(0x2D, DEC_R)              X(0x2E, LD_R_N)             X(0x2F, CPL)            \
+                                                                                                                \
+    X(0x30, JP_CC_DISP)         X(0x31, LD_RP_NN)           X(0x32, LD_IHL_A_DEC)       X(0x33, INC_RP)         \
+    X(0x34, INC_R)              X(0x35, DEC_R)              X(0x36, LD_R_N)             X(0x37, SCF)            \
+    X(0x38, JP_CC_DISP)         X(0x39, ADD_HL_RP)          X(0x3A, LD_A_IHL_DEC)       X(0x3B, DEC_RP)         \
+    X(0x3C, INC_R)              X(0x3D, DEC_R)              X(0x3E, LD_R_N)             X(0x3F, CCF)            \
+                                                                                                                \
+    _LD_R_R_ROW(X, 4)                                                                                           \
+    _LD_R_R_ROW(X, 5)                                                                                           \
+    _LD_R_R_ROW(X, 6)                                                                                           \
+    X(0x70, LD_R_R)             X(0x71, LD_R_R)             X(0x72, LD_R_R)             X(0x73, LD_R_R)         \
+    X(0x74, LD_R_R)             X(0x75, LD_R_R)             X(0x76, HALT)               X(0x77, LD_R_R)         \
+    X(0x78, LD_R_R)             X(0x79, LD_R_R)             X(0x7A, LD_R_R)             X(0x7B, LD_R_R)         \
+    X(0x7C, LD_R_R)             X(0x7D, LD_R_R)             X(0x7E, LD_R_R)             X(0x7F, LD_R_R)         \
+                                                                                                                \
+    _ALU_R_ROW(X, 8)                                                                                            \
+    _ALU_R_ROW(X, 9)                                                                                            \
+    _ALU_R_ROW(X, A)                                                                                            \
+    _ALU_R_ROW(X, B)                                                                                            \
+                                                                                                                \
+    X(0xC0, RET_CC)             X(0xC1, POP_RP)             X(0xC2, JP_CC_NN)           X(0xC3, JP_NN)          \
+    X(0xC4, CALL_CC_NN)         X(0xC5, PUSH_RP)            X(0xC6, ALU_N)              X(0xC7, RST_N)          \
+    X(0xC8, RET_CC)             X(0xC9, RET)                X(0xCA, JP_CC_NN)           X(0xCB, PREFIX_CB)      \
+    X(0xCC, CALL_CC_NN)         X(0xCD, CALL_NN)            X(0xCE, ALU_N)              X(0xCF, RST_N)          \
+                                                                                                                \
+    X(0xD0, RET_CC)             X(0xD1, POP_RP)             X(0xD2, JP_CC_NN)           X(0xD3, LOG_ERR)        \
+    X(0xD4, CALL_CC_NN)         X(0xD5, PUSH_RP)            X(0xD6, ALU_N)              X(0xD7, RST_N)          \
+    X(0xD8, RET_CC)             X(0xD9, RETI)               X(0xDA, JP_CC_NN)           X(0xDB, LOG_ERR)        \
+    X(0xDC, CALL_CC_NN)         X(0xDD, CALL_NN)            X(0xDE, ALU_N)              X(0xDF, RST_N)          \
+                                                                                                                \
+    X(0xE0, LDH_DN_A)           X(0xE1, POP_RP)             X(0xE2, LDH_IC_A)           X(0xE3, LOG_ERR)        \
+    X(0xE4, CALL_CC_NN)         X(0xE5, PUSH_RP)            X(0xE6, ALU_N)              X(0xE7, RST_N)          \
+    X(0xE8, ADD_SP_DISP)        X(0xE9, JP_HL)              X(0xEA, LD_DNN_A)           X(0xEB, LOG_ERR)        \
+    X(0xEC, CALL_CC_NN)         X(0xED, CALL_NN)            X(0xEE, ALU_N)              X(0xEF, RST_N)          \
+                                                                                                                \
+    X(0xF0, LDH_A_DN)           X(0xF1, POP_RP)             X(0xF2, LDH_A_IC)           X(0xF3, DI)             \
+    X(0xF4, CALL_CC_NN)         X(0xF5, PUSH_RP)            X(0xF6, ALU_N)              X(0xF7, RST_N)          \
+    X(0xF8, LD_HL_SP_DISP)      X(0xF9, LD_SP_HL)           X(0xFA, LD_A_DNN)           X(0xFB, EI)             \
+    X(0xFC, CALL_CC_NN)         X(0xFD, CALL_NN)            X(0xFE, ALU_N)              X(0xFF, RST_N)
+
+/**
+ * Superinstructions: opcode pairs run back to back without going through the dispatch loop in between.
+ * Copy and compare-and-branch loops of game code. Not tuned on the test ROMs, which validate the emulator:
+ * pair counts of real games can be exported with the profiler (GB_PROFILER, -p).
+*/
+#define FUSED_PAIRS(X)                                                                                          \
+    X(0x2A, 0x12)   /* LD A,(HL+)   ; LD (DE),A     */                                                          \
+    X(0x05, 0x20)   /* DEC B        ; JR NZ,e       */                                                          \
+    X(0x0D, 0x20)   /* DEC C        ; JR NZ,e       */                                                          \
+    X(0xFE, 0x20)   /* CP n         ; JR NZ,e       */                                                          \
+    X(0xFE, 0x28)   /* CP n         ; JR Z,e        */                                                          \
+    X(0xFE, 0x30)   /* CP n         ; JR NC,e       */                                                          \
+    X(0xFE, 0x38)   /* CP n         ; JR C,e        */                                                          \
+    X(0xF0, 0xE6)   /* LDH A,(n)    ; AND n         */                                                          \
+    X(0xF0, 0xFE)   /* LDH A,(n)    ; CP n          */
+
 /*-----------------------CB DECODING---------------------------*/
 
 #define _DECODE_CB_X0() do {                                    \
@@ -21,8 +126,8 @@
     }                                                           \
 } while(0)
 
-#define _DECODE_CB() do {                                       \
-    IR = READ_MEMORY(PC); PC++;                                 \
+/// CB-prefixed opcodes are regular enough to share a single body
+#define CB_INSTR() do {                                         \
     switch(OP_X) {                                              \
         case 0: _DECODE_CB_X0();    break;                      \
         case 1: BIT_R();            break;                      \
@@ -31,177 +136,48 @@
     }                                                           \
 } while(0)
 
-/*-----------------------X0 DECODING---------------------------*/
-
-#define _DECODE_X0_Z0() do {                                    \
-    switch(OP_Y) {                                              \
-        case 0: /* NOP(); */        break;                      \
-        case 1: LD_DNN_SP();        break;                      \
-        case 2: STOP();             break;                      \
-        case 3: JP_DISP();          break;                      \
-        default: JP_CC_DISP();      break;                      \
-    }                                                           \
-} while(0)
-
-#define _DECODE_X0_Z1() do {                                    \
-    switch(OP_Q) {                                              \
-        case 0: LD_RP_NN();         break;                      \
-        case 1: ADD_HL_RP();        break;                      \
-    }                                                           \
-} while(0)
-
-#define _DECODE_X0_Z2_Q0() do {                                 \
-    switch(OP_P) {                                              \
-        case 0: LD_IBC_A();         break;                      \
-        case 1: LD_IDE_A();         break;                      \
-        case 2: LD_IHL_A_INC();     break;                      \
-        case 3: LD_IHL_A_DEC();     break;                      \
-    }                                                           \
-} while(0)
-
-#define _DECODE_X0_Z2_Q1() do {                                 \
-    switch(OP_P) {                                              \
-        case 0: LD_A_IBC();         break;                      \
-        case 1: LD_A_IDE();         break;                      \
-        case 2: LD_A_IHL_INC();     break;                      \
-        case 3: LD_A_IHL_DEC();     break;                      \
-    }                                                           \
-} while(0)
+#define _CB_OPCODE_CASE(opcode)                                 \
+    case opcode: { enum { OPCODE = opcode }; CB_INSTR(); } break;
 
-#define _DECODE_X0_Z2() do {                                    \
-    switch(OP_Q) {                                              \
-        case 0: _DECODE_X0_Z2_Q0(); break;                      \
-        case 1: _DECODE_X0_Z2_Q1(); break;                      \
+#define DECODE_CB() do {                                        \
+    switch(IR) {                                                \
+        FOR_EACH_BYTE(_CB_OPCODE_CASE)                          \
     }                                                           \
 } while(0)
 
-#define _DECODE_X0_Z3() do {                                    \
-    switch(OP_Q) {                                              \
-        case 0: INC_RP();           break;                      \
-        case 1: DEC_RP();           break;                      \
-    }                                                           \
-} while(0)
-
-#define _DECODE_X0_Z7() do {                                    \
-    switch(OP_Y) {                                              \
-        case 0: RLCA();             break;                      \
-        case 1: RRCA();             break;                      \
-        case 2: RLA();              break;                      \
-        case 3: RRA();              break;                      \
-        case 4: DAA();              break;                      \
-        case 5: CPL();              break;                      \
-        case 6: SCF();              break;                      \
-        case 7: CCF();              break;                      \
-    }                                                           \
-} while(0)
-
-#define _DECODE_X0() do {                                       \
-    switch(OP_Z) {                                              \
-        case 0: _DECODE_X0_Z0();    break;                      \
-        case 1: _DECODE_X0_Z1();    break;                      \
-        case 2: _DECODE_X0_Z2();    break;                      \
-        case 3: _DECODE_X0_Z3();    break;                      \
-        case 4:     INC_R();        break;                      \
-        case 5:     DEC_R();        break;                      \
-        case 6:     LD_R_N();       break;                      \
-        case 7: _DECODE_X0_Z7();    break;                      \
-    }                                                           \
-} while(0)
-
-/*-----------------------X1 DECODING---------------------------*/
-
-#define _DECODE_X1() do {                                       \
-    if (OP_Y == 6 && OP_Z == 6) {                               \
-        HALT();                                                 \
-    } else {                                                    \
-        LD_R_R();                                               \
-    }                                                           \
+/// Expects a decode_cb() function wrapping DECODE_CB() to be in scope
+#define PREFIX_CB() do {                                        \
+    IR = READ_IMMEDIATE();                                      \
+    decode_cb(OPCODE_HANDLER_ARGS);                             \
 } while(0)
 
-/*-----------------------X3 DECODING---------------------------*/
-
-#define _DECODE_X3_Z0() do {                                    \
-    switch(OP_Y) {                                              \
-        case 4: LDH_DN_A();         break;                      \
-        case 5: ADD_SP_DISP();      break;                      \
-        case 6: LDH_A_DN();         break;                      \
-        case 7: LD_HL_SP_DISP();    break;                      \
-        default: RET_CC();          break;                      \
-    }                                                           \
-} while(0)
-
-#define _DECODE_X3_Z1_Q1() do {                                 \
-    switch(OP_P) {                                              \
-        case 0: RET();              break;                      \
-        case 1: RETI();             break;                      \
-        case 2: JP_HL();            break;                      \
-        case 3: LD_SP_HL();         break;                      \
-    }                                                           \
-} while(0)
-
-#define _DECODE_X3_Z1() do {                                    \
-    switch(OP_Q) {                                              \
-        case 0: POP_RP();           break;                      \
-        case 1: _DECODE_X3_Z1_Q1(); break;                      \
-    }                                                           \
-} while(0)
-
-#define _DECODE_X3_Z2() do {                                    \
-    switch(OP_Y) {                                              \
-        case 4: LDH_IC_A();         break;                      \
-        case 5: LD_DNN_A();         break;                      \
-        case 6: LDH_A_IC();         break;                      \
-        case 7: LD_A_DNN();         break;                      \
-        default: JP_CC_NN();        break;                      \
-    }                                                           \
-} while(0)
-
-#define _DECODE_X3_Z3() do {                                    \
-    switch(OP_Y) {                                              \
-        case 0: JP_NN();            break;                      \
-        case 1: _DECODE_CB();       break;                      \
-        case 6: DI();               break;                      \
-        case 7: EI();               break;                      \
-        default: LOG_ERR();         break;                      \
-    }                                                           \
-} while(0)
+/*----------------------FULL DECODING--------------------------*/
 
-#define _DECODE_X3_Z4() do {                                    \
-    if (OP_Y >= 4) LOG_ERR();                                   \
-    CALL_CC_NN();                                               \
-} while(0)
+/// Handlers running on a local register file (see cpudef.h) get it as an extra parameter
+#ifndef OPCODE_HANDLER_PARAMS
+#define OPCODE_HANDLER_PARAMS   GB_gameboy_t *gb
+#define OPCODE_HANDLER_ARGS     gb
+#define OPCODE_HANDLER_UNUSED() ( (void)gb )
+#endif
 
-#define _DECODE_X3_Z5() do {                                    \
-    switch(OP_Q) {                                              \
-        case 0: PUSH_RP();      break;                          \
-        case 1:                                                 \
-            if (OP_P != 0) LOG_ERR();                           \
-            CALL_NN();                                          \
-            break;                                              \
-    }                                                           \
-} while(0)
+/// Some instructions touch neither the machine nor the registers (NOP, DI...), hence OPCODE_HANDLER_UNUSED()
+#define _OPCODE_HANDLER(opcode, instr)                          \
+    static void op_##opcode(OPCODE_HANDLER_PARAMS) {            \
+        enum { OPCODE = opcode };                               \
+        OPCODE_HANDLER_UNUSED();                                \
+        instr();                                                \
+    }
 
-#define _DECODE_X3() do {                                       \
-    switch(OP_Z) {                                              \
-        case 0: _DECODE_X3_Z0();    break;                      \
-        case 1: _DECODE_X3_Z1();    break;                      \
-        case 2: _DECODE_X3_Z2();    break;                      \
-        case 3: _DECODE_X3_Z3();    break;                      \
-        case 4: _DECODE_X3_Z4();    break;                      \
-        case 5: _DECODE_X3_Z5();    break;                      \
-        case 6:     ALU_N();        break;                      \
-        case 7:     RST_N();        break;                      \
-    }                                                           \
-} while(0)
+/// Defines one op_0xNN() function per opcode, expected once in cpu.c before DECODE() is used
+#define DECL_OPCODE_HANDLERS() OPCODE_TABLE(_OPCODE_HANDLER)
 
-/*----------------------FULL DECODING--------------------------*/
+/// Handlers are static and called once here so the compiler inlines them back into the switch
+#define _OPCODE_CASE(opcode, instr)                             \
+    case opcode: op_##opcode(OPCODE_HANDLER_ARGS); break;
 
 #define DECODE() do {                                           \
-    switch(OP_X) {                                              \
-        case 0: _DECODE_X0();       break;                      \
-        case 1: _DECODE_X1();       break;                      \
-        case 2:   ALU_R();          break;                      \
-        case 3: _DECODE_X3();       break;                      \
+    switch(IR) {                                                \
+        OPCODE_TABLE(_OPCODE_CASE)                              \
     }                                                           \
 } while(0)
 
@@ -7,8 +7,6 @@
 #include "defs.h"
 #include "gb_utils.h"
 
-#include <stddef.h>
-
 #define ABS(n) (n < 0 ? -n : n)
 
 #define ZF_TOGGLE (0x80)
@@ -16,19 +14,6 @@
 #define HF_TOGGLE (0x20)
 #define CF_TOGGLE (0x10)
 
-/// Extracts flag from F register
-#define F_Z (rF & ZF_TOGGLE)
-#define F_N (rF & NF_TOGGLE)
-#define F_H (rF & HF_TOGGLE)
-#define F_C (rF & CF_TOGGLE)
-#define F_NHC (F_N | F_H | F_C)
-
-/// Extract flag value as boolean
-#define ZF  (rF >> 7)
-#define NF ((rF >> 6) & 1)
-#define HF ((rF >> 5) & 1)
-#define CF ((rF >> 4) & 1)
-
 #define ZF_CHECK(byte)          ( ( ( byte & 0xFF ) == 0 ) << 7 )
 #define HF_ADC_CHECK(a, b, c)   ( ( ( (a & 0xF) + (b & 0xF) + (c & 0xF) ) & 0x10 ) << 1 )          /* Half-carry bit = bit 3   */
 #define HF_SBC_CHECK(a, b, c)   ( ( ( (a & 0xF) - (b & 0xF) - (c & 0xF) ) & 0x10 ) << 1 )          /* Half-carry bit = bit 3   */
@@ -40,6 +25,108 @@
 #define HF_CHECK16(res, a, b)   ( ( ( ( res ^ a ^ b ) >> 8 ) & 0x10 ) << 1 )
 #define CF_CHECK16(a, b)        ( ( a > 0xFFFF - b ) << 4 )
 
+/**
+ * Lazy flags
+ *
+ * 8-bit ALU instructions (ADD, ADC, SUB, SBC, CP, INC, DEC, AND, XOR, OR) only record their kind, operands and result.
+ * F is computed from that record when something actually reads it: Z and C on their own for condition checks and
+ * carry inputs, the whole register for N/H reads (DAA) and PUSH AF.
+ * Any other instruction writing F goes through SET_FLAGS() which drops the pending record.
+*/
+enum {
+    FLAGS_OP_NONE,                                  // F is up to date
+    FLAGS_OP_ADD,
+    FLAGS_OP_ADC,
+    FLAGS_OP_SUB,                                   // SUB and CP
+    FLAGS_OP_SBC,
+    FLAGS_OP_INC,
+    FLAGS_OP_DEC,
+    FLAGS_OP_AND,
+    FLAGS_OP_OR                                     // OR and XOR
+};
+
+#define SET_LAZY_FLAGS(op, lhs, rhs, carry, res) do {           \
+    BYTE _c = (carry); /* May read the pending record */        \
+    gb->state.cpu.flags_op       = op;                          \
+    gb->state.cpu.flags_lhs      = lhs;                         \
+    gb->state.cpu.flags_rhs      = rhs;                         \
+    gb->state.cpu.flags_carry    = _c;                          \
+    gb->state.cpu.flags_res      = res;                         \
+} while(0)
+
+#define SET_FLAGS(value) do {                                   \
+    BYTE _f = (value);                                          \
+    gb->state.cpu.flags_op = FLAGS_OP_NONE;                     \
+    rF = _f;                                                    \
+} while(0)
+
+/* Helpers take F as a value so they work whatever register file the caller runs on (see cpudef.h) */
+
+static inline BYTE lazy_flag_z(const GB_cpu_t *cpu, BYTE f) {
+    if (cpu->flags_op == FLAGS_OP_NONE) return f & ZF_TOGGLE;
+    return ZF_CHECK(cpu->flags_res);
+}
+
+static inline BYTE lazy_flag_c(const GB_cpu_t *cpu, BYTE f) {
+    int a = cpu->flags_lhs, b = cpu->flags_rhs, c = cpu->flags_carry;
+
+    switch (cpu->flags_op) {
+        case FLAGS_OP_NONE: return f & CF_TOGGLE;
+        case FLAGS_OP_ADD:  return CF_CHECK(a, b);
+        case FLAGS_OP_ADC:  return CF_CHECK(a, (b + c));
+        case FLAGS_OP_SUB:  return CF_BORROW(a, b);
+        case FLAGS_OP_SBC:  return CF_BORROW(a, (b + c));
+        case FLAGS_OP_INC:
+        case FLAGS_OP_DEC:  return c; /* Carry flag was not affected */
+        default:            return 0;
+    }
+}
+
+static inline BYTE lazy_flag_h(const GB_cpu_t *cpu) {
+    int a = cpu->flags_lhs, b = cpu->flags_rhs, c = cpu->flags_carry;
+
+    switch (cpu->flags_op) {
+        case FLAGS_OP_ADD:  return HF_ADD_CHECK(a, b);
+        case FLAGS_OP_ADC:  return HF_ADC_CHECK(a, b, c);
+        case FLAGS_OP_SUB:  return HF_SUB_CHECK(a, b);
+        case FLAGS_OP_SBC:  return HF_SBC_CHECK(a, b, c);
+        case FLAGS_OP_INC:  return HF_ADD_CHECK(a, 1);
+        case FLAGS_OP_DEC:  return HF_SUB_CHECK(a, 1);
+        case FLAGS_OP_AND:  return HF_TOGGLE;
+        default:            return 0;
+    }
+}
+
+/// Drops the pending record, returns F with the flags it held
+static inline BYTE lazy_flags(GB_cpu_t *cpu, BYTE f) {
+    int op = cpu->flags_op;
+
+    if (op != FLAGS_OP_NONE) {
+        int nf = (op == FLAGS_OP_SUB || op == FLAGS_OP_SBC || op == FLAGS_OP_DEC) ? NF_TOGGLE : 0;
+        f = lazy_flag_z(cpu, f) | nf | lazy_flag_h(cpu) | lazy_flag_c(cpu, f);
+        cpu->flags_op = FLAGS_OP_NONE;
+    }
+
+    return f;
+}
+
+/// Materializes pending flags into F and returns it
+#define FLAGS       ( rF = lazy_flags(&gb->state.cpu, rF) )
+#define SYNC_FLAGS() ( (void)FLAGS )
+
+/// Extracts flag from F register
+#define F_Z lazy_flag_z(&gb->state.cpu, rF)
+#define F_N (FLAGS & NF_TOGGLE)
+#define F_H (FLAGS & HF_TOGGLE)
+#define F_C lazy_flag_c(&gb->state.cpu, rF)
+#define F_NHC (F_N | F_H | F_C)
+
+/// Extract flag value as boolean
+#define ZF  (F_Z >> 7)
+#define NF ((F_N >> 6) & 1)
+#define HF ((F_H >> 5) & 1)
+#define CF ((F_C >> 4) & 1)
+
 #define MSB(word)               ( ( word >> 8 ) & 0xFF  )
 #define LSB(word)               (   word        & 0xFF  )
 
@@ -55,50 +142,52 @@ static inline BYTE read_memory(GB_gameboy_t *gb, WORD addr) {
     return res; 
 }
 
+/// Reads the immediate at addr (PC++), cached instructions already carry their immediates
+static inline BYTE read_immediate(GB_gameboy_t *gb, WORD addr) {
+    const GB_decoded_instr_t *instr = gb->exec->instr;
+    BYTE res = instr ? instr->operands[addr - instr->pc - 1] : GB_mem_read(gb, addr);
+    INC_CYCLE();
+    return res;
+}
+
 #define READ_MEMORY(addr) read_memory(gb, addr)
+#define READ_IMMEDIATE() read_immediate(gb, PC++)
 #define WRITE_MEMORY(addr, data) do {               \
-    GB_mem_write(gb, addr, data);                   \
+    GB_cpu_write(gb, addr, data);                   \
     INC_CYCLE();                                    \
 } while(0)
 
-static long REGISTER_OFFSET_TABLE[8] = {
-    offsetof(GB_cpu_t, bc.b.h),  /* B */
-    offsetof(GB_cpu_t, bc.b.l),  /* C */
-    offsetof(GB_cpu_t, de.b.h),  /* D */
-    offsetof(GB_cpu_t, de.b.l),  /* E */
-    offsetof(GB_cpu_t, hl.b.h),  /* H */
-    offsetof(GB_cpu_t, hl.b.l),  /* L */
-    0,                          /* (HL) */
-    offsetof(GB_cpu_t, af.b.h)   /* A */
-};
-
-static long REGISTER_PAIR_OFFSET_TABLE[4] = {
-    offsetof(GB_cpu_t, bc.w),    /* BC */
-    offsetof(GB_cpu_t, de.w),    /* DE */
-    offsetof(GB_cpu_t, hl.w),    /* HL */
-    offsetof(GB_cpu_t, sp.w)     /* SP */
-};
-
-static long REGISTER_PAIR2_OFFSET_TABLE[4] = {
-    offsetof(GB_cpu_t, bc.w),    /* BC */
-    offsetof(GB_cpu_t, de.w),    /* DE */
-    offsetof(GB_cpu_t, hl.w),    /* HL */
-    offsetof(GB_cpu_t, af.w)     /* AF */
-};
-
 /* Select register in opcode byte */
 /* |7|6|5|4|3|2|1|0|    */
 /*      ~~~~~ ~~~~~     */
 /*        |     |____ Z */
 /*        |__________ Y */
-#define REGISTER(index)      ( *( (BYTE*)(gb->cpu) + REGISTER_OFFSET_TABLE[ index & 7 ] ) ) // Note to self: 0b111 = 7
-#define REGISTER_PAIR(table) ( *(WORD *)(void *)( (char*)(gb->cpu) + table[ OP_P ] ) )
+/* Opcode fields are constants in every handler (see decode.h) so the selection folds into a direct access */
+#define _REGISTER_PTR(index) (                                                  \
+    ( (index & 7) == 0 ) ? &rB :                                                \
+    ( (index & 7) == 1 ) ? &rC :                                                \
+    ( (index & 7) == 2 ) ? &rD :                                                \
+    ( (index & 7) == 3 ) ? &rE :                                                \
+    ( (index & 7) == 4 ) ? &rH :                                                \
+    ( (index & 7) == 5 ) ? &rL :                                                \
+    ( (index & 7) == 6 ) ? &rZ : /* (HL), never accessed as a register */       \
+                           &rA                                                  \
+)
+
+#define _REGISTER_PAIR_PTR(last) (                                             \
+    ( OP_P == 0 ) ? &rBC :                                                      \
+    ( OP_P == 1 ) ? &rDE :                                                      \
+    ( OP_P == 2 ) ? &rHL :                                                      \
+                    &last                                                       \
+)
+
+#define REGISTER(index)      ( *_REGISTER_PTR(index) )
 
 #define RY  REGISTER(OP_Y)
 #define RZ  REGISTER(OP_Z)
 
-#define RP  ( REGISTER_PAIR(REGISTER_PAIR_OFFSET_TABLE) )
-#define RP2 ( REGISTER_PAIR(REGISTER_PAIR2_OFFSET_TABLE) )
+#define RP  ( *_REGISTER_PAIR_PTR(SP)  )   /* BC, DE, HL, SP */
+#define RP2 ( *_REGISTER_PAIR_PTR(rAF) )   /* BC, DE, HL, AF */
 
 // Note: Set and Get register macros allow operating on registers without worriying about r/w (HL)
 
@@ -119,7 +208,7 @@ static long REGISTER_PAIR2_OFFSET_TABLE[4] = {
 #define GET_RZ()            GET_REGISTER(OP_Z)
 
 static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
-#define CC(index) ( !( rF & CC_TABLE[(index&3)] ) ^ ((index&3) & 1) ) /* Condition Check */
+#define CC(index) ( !( ((index&3) < 2 ? F_Z : F_C) & CC_TABLE[(index&3)] ) ^ ((index&3) & 1) ) /* Condition Check */
 
 
 /*------------------------------------------------------8-bit load instructions-------------------------------------------------------*/
@@ -143,7 +232,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * M-Cycles: 2
 */
 #define LD_R_N() do {                       			\
-    rZ = READ_MEMORY(PC++);                 			\
+    rZ = READ_IMMEDIATE();                  			\
     SET_RY(rZ);                              			\
 } while(0)
 
@@ -202,8 +291,8 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * M-Cycles: 4
 */
 #define LD_A_DNN() do {                     			\
-    rZ = READ_MEMORY(PC++);                  			\
-    rW = READ_MEMORY(PC++);                  			\
+    rZ = READ_IMMEDIATE();                   			\
+    rW = READ_IMMEDIATE();                   			\
     _LD_A_INDIRECT(WZ);                     			\
 } while(0)
 
@@ -214,8 +303,8 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * M-Cycles: 4
 */
 #define LD_DNN_A() do {                     			\
-    rZ = READ_MEMORY(PC++);                  			\
-    rW = READ_MEMORY(PC++);                  			\
+    rZ = READ_IMMEDIATE();                   			\
+    rW = READ_IMMEDIATE();                   			\
     _LD_INDIRECT_A(WZ);                     			\
 } while(0)
 
@@ -269,7 +358,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * M-Cycles: 3
 */
 #define LDH_A_DN() do {                     			\
-    rZ = READ_MEMORY(PC++);                  			\
+    rZ = READ_IMMEDIATE();                   			\
     _LDH_A_INDIRECT(rZ);                     			\
 } while(0)
 
@@ -280,7 +369,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * M-Cycles: 3
 */
 #define LDH_DN_A() do {                     			\
-    rZ = READ_MEMORY(PC++);                  			\
+    rZ = READ_IMMEDIATE();                   			\
     _LDH_INDIRECT_A(rZ);                     			\
 } while(0)
 
@@ -335,8 +424,8 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * M-Cycles: 3
 */
 #define LD_RP_NN() do {                     			\
-    rZ  = READ_MEMORY(PC++);                			\
-    rW  = READ_MEMORY(PC++);                			\
+    rZ  = READ_IMMEDIATE();                 			\
+    rW  = READ_IMMEDIATE();                 			\
     RP  = WZ;                               			\
 } while(0)
 
@@ -347,8 +436,8 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * M-Cycles: 5
 */
 #define LD_DNN_SP() do {                    			\
-    rZ  = READ_MEMORY(PC++);                			\
-    rW  = READ_MEMORY(PC++);                			\
+    rZ  = READ_IMMEDIATE();                 			\
+    rW  = READ_IMMEDIATE();                 			\
     WRITE_MEMORY(WZ, SPl); WZ++; /* lsb */  			\
     WRITE_MEMORY(WZ, SPh);       /* msb */  			\
 } while(0)
@@ -371,6 +460,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * M-Cycles: 4
 */
 #define PUSH_RP() do {                      			\
+    if (OP_P == 3) SYNC_FLAGS(); /* PUSH AF */			\
     WORD rr = RP2;                          			\
     INC_CYCLE();                                        \
     SP--; WRITE_MEMORY(SP, MSB(rr)); /* M2/M3 */		\
@@ -387,6 +477,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
     rZ = READ_MEMORY(SP++);      /* M2 */    			\
     rW = READ_MEMORY(SP++);      /* M3 */    			\
     RP2 = WZ;                   /* M4 */    			\
+    if (OP_P == 3) gb->state.cpu.flags_op = FLAGS_OP_NONE;	\
     rF &= 0xF0; /* Ensure low nibble is 0 */ 			\
 } while(0)
 
@@ -397,11 +488,11 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * M-Cycles: 3
 */
 #define LD_HL_SP_DISP() do {                			\
-    rZ = READ_MEMORY(PC++);                  			\
+    rZ = READ_IMMEDIATE();                   			\
     int res = SP + (SIGNED_BYTE)rZ;          			\
     rHL = res;                               			\
-    rF = HF_ADD_CHECK(SPl, (SIGNED_BYTE)rZ) 	|		\
-        CF_CHECK(SPl, rZ);                    			\
+    SET_FLAGS(HF_ADD_CHECK(SPl, (SIGNED_BYTE)rZ) 	|		\
+        CF_CHECK(SPl, rZ));                   			\
     INC_CYCLE();                            			\
 } while(0)
 
@@ -420,10 +511,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
 */
 #define ADD_R(rhs) do {                     			\
     int res = rA + rhs;                      			\
-    rF = ZF_CHECK(res)               			|		\
-        0                           			|		\
-        HF_ADD_CHECK(rA, rhs)        			|		\
-        CF_CHECK(rA, rhs);                   			\
+    SET_LAZY_FLAGS(FLAGS_OP_ADD, rA, rhs, 0, res);		\
     rA = res;                                			\
 } while(0)
 
@@ -436,11 +524,9 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * M-Cycles: 1
 */
 #define ADC_R(rhs) do {                     			\
-    int res = rA + rhs + CF;                 			\
-    rF = ZF_CHECK(res)               			|		\
-        0                           			|		\
-        HF_ADC_CHECK(rA, rhs, CF)    			|		\
-        CF_CHECK(rA, (rhs+CF));              			\
+    int cf = CF;                             			\
+    int res = rA + rhs + cf;                 			\
+    SET_LAZY_FLAGS(FLAGS_OP_ADC, rA, rhs, cf, res);		\
     rA = res;                                			\
 } while(0)
 
@@ -452,10 +538,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
 */
 #define SUB_R(rhs) do {                     			\
     int res = rA - rhs;                      			\
-    rF = ZF_CHECK(res)               			|		\
-        NF_TOGGLE                   			|		\
-        HF_SUB_CHECK(rA, rhs)        			|		\
-        CF_BORROW(rA, rhs);                  			\
+    SET_LAZY_FLAGS(FLAGS_OP_SUB, rA, rhs, 0, res);		\
     rA = res;                                			\
 } while(0)
 
@@ -467,11 +550,9 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
 */
 #define SBC_R(rhs) do {                     			\
     /* NOT SURE ABOUT THIS ONE */           			\
-    int res = rA - rhs - CF;                 			\
-    rF = ZF_CHECK(res)               			|		\
-        NF_TOGGLE                   			|		\
-        HF_SBC_CHECK(rA, rhs, CF)    			|		\
-        CF_BORROW(rA, (rhs+CF));             			\
+    int cf = CF;                             			\
+    int res = rA - rhs - cf;                 			\
+    SET_LAZY_FLAGS(FLAGS_OP_SBC, rA, rhs, cf, res);		\
     rA = res;                                			\
 } while(0)
 
@@ -487,14 +568,12 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
     rA = a;                                  			\
 } while(0)
 
-#define _INC_R(inc_val, nf, hf_check) do {  			\
+#define _INC_R(inc_val, flags_op) do {      			\
     BYTE ry = GET_RY();                     			\
     int res = ry + inc_val;                 			\
     SET_RY(res);                            			\
-    rF = ZF_CHECK(res)               			|		\
-        nf                          			|		\
-        hf_check(ry, ABS(inc_val))  			|		\
-        F_C; /* Carry flag not affected */  			\
+    /* Carry flag not affected */           			\
+    SET_LAZY_FLAGS(flags_op, ry, 1, F_C, res);  		\
 } while(0)
 
 /**
@@ -503,7 +582,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * Flags: rZ = zero, N = 0, H = half-carry, C = not affected
  * M-Cycles: 1
 */
-#define INC_R() _INC_R(1, 0, HF_ADD_CHECK)
+#define INC_R() _INC_R(1, FLAGS_OP_INC)
 
 /**
  * DEC r: Deccrement (register)
@@ -511,7 +590,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * Flags: rZ = zero, N = 1, H = half-carry, C = not affected
  * M-Cycles: 1
 */
-#define DEC_R() _INC_R(-1, NF_TOGGLE, HF_SUB_CHECK)
+#define DEC_R() _INC_R(-1, FLAGS_OP_DEC)
 
 /**
  * Customizable macro for bitwise operation on accumulator
@@ -519,12 +598,9 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * Flags: rZ = zero, N = 0, H = depends, C = 0
  * M-Cycles: 1
 */
-#define _BITWISE_R(rhs, operator, hf) do {  			\
+#define _BITWISE_R(rhs, operator, flags_op) do {  		\
     rA operator##= rhs;                      			\
-    rF = ZF_CHECK(rA)                 			|		\
-        0                           			|		\
-        hf                          			|		\
-        0;                                  			\
+    SET_LAZY_FLAGS(flags_op, 0, 0, 0, rA);   			\
 } while(0)
 
 /**
@@ -533,7 +609,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * Flags: rZ = zero, N = 0, H = 1, C = 0
  * M-Cycles: 1
 */
-#define AND_R(rhs) _BITWISE_R(rhs, &, HF_TOGGLE);
+#define AND_R(rhs) _BITWISE_R(rhs, &, FLAGS_OP_AND);
 
 /**
  * OR r: Bitwise OR (register)
@@ -541,7 +617,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * Flags: rZ = zero, N = 0, H = 0, C = 0
  * M-Cycles: 1
 */
-#define OR_R(rhs) _BITWISE_R(rhs, |, 0);
+#define OR_R(rhs) _BITWISE_R(rhs, |, FLAGS_OP_OR);
 
 /**
  * XOR r: Bitwise XOR (register)
@@ -549,7 +625,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * Flags: rZ = zero, N = 0, H = 0, C = 0
  * M-Cycles: 1
 */
-#define XOR_R(rhs) _BITWISE_R(rhs, ^, 0);
+#define XOR_R(rhs) _BITWISE_R(rhs, ^, FLAGS_OP_OR);
 
 #define ALU(rhs) do {                       			\
     BYTE b = rhs;                           			\
@@ -577,7 +653,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * M-Cycles: n+1
 */
 #define ALU_N() do {                        			\
-    rZ = READ_MEMORY(PC++);                  			\
+    rZ = READ_IMMEDIATE();                   			\
     ALU(rZ);                                 			\
 } while(0)
 
@@ -588,10 +664,10 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * M-Cycles: 1
 */
 #define CCF() do {                          			\
-    rF = F_Z                         			|		\
+    SET_FLAGS(F_Z                   			|		\
         0                           			|		\
         0                           			|		\
-        (!CF << 4);                         			\
+        (!CF << 4));                        			\
 } while(0)
 
 /**
@@ -601,10 +677,10 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * M-Cycles: 1
 */
 #define SCF() do {                          			\
-    rF = F_Z                         			|		\
+    SET_FLAGS(F_Z                   			|		\
         0                           			|		\
         0                           			|		\
-        CF_TOGGLE;            			                \
+        CF_TOGGLE);           			                \
 } while(0)
 
 /**
@@ -633,10 +709,10 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
         (!NF && rA > 0x99) || CF;            			\
     if (bcd_carry) res |= 0x60;             			\
     res = NF ? (rA - res) : (rA + res);       			\
-    rF = ZF_CHECK(res)               			|		\
+    SET_FLAGS(ZF_CHECK(res)         			|		\
         F_N                         			|		\
         0                           			|		\
-        (bcd_carry << 4);                   			\
+        (bcd_carry << 4));                  			\
     rA = res;                                			\
 } while(0)
 
@@ -648,10 +724,10 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
 */
 #define CPL() do {                          			\
     rA = ~rA;                                 			\
-    rF = F_Z                         			|		\
+    SET_FLAGS(F_Z                   			|		\
         NF_TOGGLE                   			|		\
         HF_TOGGLE                   			|		\
-        F_C;                                			\
+        F_C);                               			\
 } while(0)
 
 /*--------------------------------------------------16-bit arithmetic instructions---------------------------------------------------*/
@@ -691,10 +767,10 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
 #define ADD_HL_RP() do {                    			\
     WORD rp = RP;                           			\
     int res = rHL + rp;                      			\
-    rF = F_Z                         			|		\
+    SET_FLAGS(F_Z                   			|		\
         0                           			|		\
         HF_CHECK16(res, rHL, rp)     			|		\
-        CF_CHECK16(rHL, rp);                 			\
+        CF_CHECK16(rHL, rp));                			\
     rHL = res;                               			\
     INC_CYCLE();                            			\
 } while(0)
@@ -711,13 +787,13 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
 */
 #define ADD_SP_DISP() do {                  			\
     /* M2 */                                            \
-    rZ = READ_MEMORY(PC++);                  			\
+    rZ = READ_IMMEDIATE();                   			\
     INC_CYCLE();                           			    \
     int res = SP + (SIGNED_BYTE)rZ;          			\
-    rF = 0                           			|		\
+    SET_FLAGS(0                     			|		\
          0                           			|		\
         HF_ADD_CHECK(SPl, (SIGNED_BYTE)rZ) 		|		\
-        CF_CHECK(SPl, rZ);                   			\
+        CF_CHECK(SPl, rZ));                  			\
     INC_CYCLE();                           			    \
     SP = WZ = res;                          			\
 } while(0)
@@ -739,10 +815,10 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
 */
 #define RLC(reg) do {                       			\
     reg = (reg << 1) | (reg >> 7);          			\
-    rF = ZF_CHECK(reg)               			|		\
+    SET_FLAGS(ZF_CHECK(reg)         			|		\
         0                           			|		\
         0                           			|		\
-        (LSb(reg) << 4);                    			\
+        (LSb(reg) << 4));                   			\
 } while(0);
 
 /**
@@ -753,7 +829,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
 */
 #define RLCA() do {                         			\
     RLC(rA);                                 			\
-    rF = F_C; /* Only keep carry flag */     			\
+    SET_FLAGS(F_C); /* Only keep carry flag */			\
 } while(0);                                 			\
 
 /**
@@ -771,10 +847,10 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
 */
 #define RRC(reg) do {                       			\
     reg = (reg >> 1) | (LSb(reg) << 7);     			\
-    rF = ZF_CHECK(reg)               			|		\
+    SET_FLAGS(ZF_CHECK(reg)         			|		\
         0                           			|		\
         0                           			|		\
-        ( MSb(reg) << 4 );                  			\
+        ( MSb(reg) << 4 ));                 			\
 } while(0)
 
 /**
@@ -785,7 +861,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
 */
 #define RRCA() do {                         			\
     RRC(rA);                                 			\
-    rF = F_C; /* Only keep carry flag */     			\
+    SET_FLAGS(F_C); /* Only keep carry flag */			\
 } while(0);     
 
 /**
@@ -800,10 +876,10 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
 */
 #define RL(reg) do {                        			\
     int res = (reg << 1) | CF;              			\
-    rF = ZF_CHECK(res)               			|		\
+    SET_FLAGS(ZF_CHECK(res)         			|		\
         0                           			|		\
         0                           			|		\
-        ( MSb(reg) << 4 );                  			\
+        ( MSb(reg) << 4 ));                 			\
     reg = res;                              			\
 } while(0)
 
@@ -815,7 +891,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
 */
 #define RLA() do {                          			\
     RL(rA);                                  			\
-    rF = F_C;                                			\
+    SET_FLAGS(F_C);                         			\
 } while(0)
 
 /**
@@ -831,10 +907,10 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
 #define RR(reg) do {                        			\
     int cf = LSb(reg) << 4;                 			\
     reg = (reg >> 1) | (CF<<7);             			\
-    rF = ZF_CHECK(reg)               			|		\
+    SET_FLAGS(ZF_CHECK(reg)         			|		\
         0                           			|		\
         0                           			|		\
-        cf;                                 			\
+        cf);                                			\
 } while(0)
 
 /**
@@ -845,7 +921,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
 */
 #define RRA() do {                          			\
     RR(rA);                                  			\
-    rF = F_C;                                			\
+    SET_FLAGS(F_C);                         			\
 } while(0)
 
 /**
@@ -859,10 +935,10 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
 #define SLA(reg) do {                       			\
     BYTE cf = MSb(reg) << 4;                			\
     reg <<= 1;                              			\
-    rF = ZF_CHECK(reg)               			|		\
+    SET_FLAGS(ZF_CHECK(reg)         			|		\
         0                           			|		\
         0                           			|		\
-        cf;                                 			\
+        cf);                                			\
 } while(0)
 
 /**
@@ -876,10 +952,10 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
 */
 #define SRA(reg) do {                       			\
     int res = (reg & 0x80) | (reg>>1);      			\
-    rF = ZF_CHECK(res)               			|		\
+    SET_FLAGS(ZF_CHECK(res)         			|		\
         0                           			|		\
         0                           			|		\
-        (LSb(reg) << 4);                    			\
+        (LSb(reg) << 4));                   			\
     reg = res;                              			\
 } while(0)
 
@@ -894,10 +970,10 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
 #define SRL(reg) do {                       			\
     int cf = LSb(reg) << 4;                 			\
     reg >>= 1;                              			\
-    rF = ZF_CHECK(reg)               			|		\
+    SET_FLAGS(ZF_CHECK(reg)         			|		\
         0                           			|		\
         0                           			|		\
-        cf;                                 			\
+        cf);                                			\
 } while(0)
 
 /**
@@ -908,7 +984,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
 */
 #define SWAP_R(reg) do {                    			\
     reg = (LNIBBLE(reg)<<4) | HNIBBLE(reg); 			\
-    rF = ZF_CHECK(reg);                      			\
+    SET_FLAGS(ZF_CHECK(reg));               			\
 } while(0)
 
 #define ROT(reg) do {                       			\
@@ -938,10 +1014,10 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
 */
 #define BIT_R() do {                        			\
     int test = GET_RZ() & (1 << OP_Y);      			\
-    rF = ZF_CHECK(test)              			|		\
+    SET_FLAGS(ZF_CHECK(test)        			|		\
         0                           			|		\
         HF_TOGGLE                   			|		\
-        F_C;                                			\
+        F_C);                               			\
 } while(0)
 
 /**
@@ -975,8 +1051,8 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * M-Cycles: 4
 */
 #define JP_NN() do {                        			\
-    rZ  = READ_MEMORY(PC++);        /* M2 */   	        \
-    rW  = READ_MEMORY(PC++);        /* M3 */   	        \
+    rZ  = READ_IMMEDIATE();         /* M2 */   	        \
+    rW  = READ_IMMEDIATE();         /* M3 */   	        \
     PC  = WZ;                       /* M4 */       	    \
     INC_CYCLE();                            			\
 } while(0)
@@ -999,8 +1075,8 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  *           3 (cc false)
 */
 #define JP_CC_NN() do {                     			\
-    rZ = READ_MEMORY(PC++);                  			\
-    rW = READ_MEMORY(PC++);                  			\
+    rZ = READ_IMMEDIATE();                   			\
+    rW = READ_IMMEDIATE();                   			\
     if (CC(OP_Y)) {                         			\
         PC = WZ;                            			\
         INC_CYCLE();                        			\
@@ -1014,7 +1090,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * M-Cycles: 3
 */
 #define JP_DISP() do {                      			\
-    rZ = READ_MEMORY(PC++);                  			\
+    rZ = READ_IMMEDIATE();                   			\
     WZ = PC + (SIGNED_BYTE)rZ;               			\
     PC = WZ;                                			\
     INC_CYCLE();                            			\
@@ -1028,7 +1104,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  *           2 (cc false)
 */
 #define JP_CC_DISP() do {                   			\
-    rZ = READ_MEMORY(PC++);                  			\
+    rZ = READ_IMMEDIATE();                   			\
     WZ = PC + (SIGNED_BYTE)rZ;               			\
     if (CC(OP_Y-4)) {                       			\
         PC = WZ;                            			\
@@ -1043,8 +1119,8 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * M-Cycles: 6
 */
 #define CALL_NN() do {                      			\
-    rZ = READ_MEMORY(PC++);                  			\
-    rW = READ_MEMORY(PC++);                  			\
+    rZ = READ_IMMEDIATE();                   			\
+    rW = READ_IMMEDIATE();                   			\
     INC_CYCLE();                            			\
     SP--; WRITE_MEMORY(SP, PCh);            			\
     SP--; WRITE_MEMORY(SP, PCl);            			\
@@ -1059,8 +1135,8 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  *           3 (cc false)
 */
 #define CALL_CC_NN() do {                   			\
-    rZ = READ_MEMORY(PC++);                  			\
-    rW = READ_MEMORY(PC++);                  			\
+    rZ = READ_IMMEDIATE();                   			\
+    rW = READ_IMMEDIATE();                   			\
     if (CC(OP_Y)) {                         			\
         INC_CYCLE();                        			\
         SP--; WRITE_MEMORY(SP, PCh);        			\
@@ -1128,6 +1204,15 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
 
 /*-------------------------------------------------Miscellaneous instructions--------------------------------------------------------*/
 
+/**
+ * NOP: No operation
+ * 
+ * Flags: -
+ * M-Cycles: 1
+*/
+#define NOP() do {                          			\
+} while(0)
+
 /**
  * HALT: Halt system clock
  * 
@@ -1135,7 +1220,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * M-Cycles: 1
 */
 #define HALT() do {                         			\
-    gb->cpu->is_halted = 1;                             \
+    gb->state.cpu.is_halted = 1;                        \
 } while(0)
 
 /**
@@ -1165,7 +1250,7 @@ static const BYTE CC_TABLE[4] = { ZF_TOGGLE, ZF_TOGGLE, CF_TOGGLE, CF_TOGGLE };
  * M-Cycles: 1
 */
 #define EI() do {                           			\
-    gb->cpu->ei_delay = 1;                              \
+    gb->state.cpu.ei_delay = 1;                         \
 } while(0)
 
 #endif
@@ -12,9 +12,10 @@
 
 #define INT_DEFAULT (0xE0)
 
-#define REQUEST_INTERRUPT(b)    ( gb->io_regs[0xF] |= b )
-#define ENABLE_INTERRUPT(b)     ( gb->ie |= b           )
-#define DISABLE_INTERRUPT(b)    ( gb->ie &= ~b          )
+#define REQUEST_INTERRUPT(b)    ( gb->state.io_regs[0xF] |= b )
+#define ENABLE_INTERRUPT(b)     ( gb->state.ie |= b           )
+#define DISABLE_INTERRUPT(b)    ( gb->state.ie &= ~b          )
+#define PENDING_INTERRUPTS()    ( gb->state.ie & gb->state.io_regs[0xF] & 0x1F )
 
 // This call is supposed to happen after next instruction fetching
 void GB_interrupt_handle(GB_gameboy_t *gb, BYTE ir, BYTE prev_ir);
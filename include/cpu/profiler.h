@@ -0,0 +1,79 @@
+#ifndef GB_PROFILER_H_
+#define GB_PROFILER_H_
+
+#include "defs.h"
+#include "type.h"
+
+#include <stdint.h>
+
+/**
+ * Opcode profiler: executions and T-cycles per opcode, CB-prefixed ones included, and counts of consecutive opcode pairs.
+ * Only built with GB_PROFILER defined (cmake -DGEMUBOY_PROFILER=ON), the hooks below expand to nothing otherwise.
+*/
+
+#define GB_PROFILER_CB_OFFSET   (0x100)
+#define GB_PROFILER_SLOTS       (0x200)     // Base opcodes then CB ones
+#define GB_PROFILER_TOP_PAIRS   (64)        // Most frequent pairs exported
+
+typedef struct {
+    uint64_t    count[GB_PROFILER_SLOTS];
+    uint64_t    t_cycles[GB_PROFILER_SLOTS];    // Fetch of the next opcode included, interrupt dispatch excluded
+    uint64_t    halted_t_cycles;
+    uint64_t    pair_count[256][256];           // By first then second base opcode, candidates for FUSED_PAIRS
+
+    int         prev_op;                        // Instruction recorded last, -1 when HALT mode came in between
+    int         cur_op;                         // Instruction being recorded
+    uint64_t    cur_t;                          // t_cycle_counter when it started
+} GB_profiler_t;
+
+GB_profiler_t*  GB_profiler_create();
+void            GB_profiler_destroy(GB_profiler_t *profiler);
+
+/**
+ * Writes the non-zero counters to path, as JSON when it ends with ".json", CSV otherwise, then the GB_PROFILER_TOP_PAIRS
+ * most frequent pairs (CSV rows with both opcodes joined by '+'). Returns 0 on success
+*/
+int             GB_profiler_export(const GB_profiler_t *profiler, const char *path);
+
+#ifdef GB_PROFILER
+
+/// Opens the record of the instruction in IR, or of the HALT mode cycles
+#define PROFILE_INSTR_BEGIN() do {                                                                              \
+    GB_profiler_t *_profiler = gb->exec->profiler;                                                              \
+    if (_profiler) {                                                                                            \
+        _profiler->cur_op   = IR & 0xFF;                                                                        \
+        _profiler->cur_t    = gb->state.cpu.t_cycle_counter;                                                    \
+    }                                                                                                           \
+} while(0)
+#define PROFILE_HALT_BEGIN() PROFILE_INSTR_BEGIN()
+
+/// Closes it once executed, right before the fetch cycle: IR then holds the CB opcode of a $CB instruction
+#define PROFILE_INSTR_END() do {                                                                                \
+    GB_profiler_t *_profiler = gb->exec->profiler;                                                              \
+    if (_profiler) {                                                                                            \
+        int _slot = _profiler->cur_op == 0xCB ? GB_PROFILER_CB_OFFSET | (IR & 0xFF) : _profiler->cur_op;        \
+        _profiler->count[_slot]++;                                                                              \
+        _profiler->t_cycles[_slot] += gb->state.cpu.t_cycle_counter - _profiler->cur_t + 4;                     \
+        if (_profiler->prev_op >= 0) _profiler->pair_count[_profiler->prev_op][_profiler->cur_op]++;            \
+        _profiler->prev_op = _profiler->cur_op;                                                                 \
+    }                                                                                                           \
+} while(0)
+
+#define PROFILE_HALT_END() do {                                                                                 \
+    GB_profiler_t *_profiler = gb->exec->profiler;                                                              \
+    if (_profiler) {                                                                                            \
+        _profiler->halted_t_cycles += gb->state.cpu.t_cycle_counter - _profiler->cur_t;                         \
+        _profiler->prev_op          = -1;                                                                       \
+    }                                                                                                           \
+} while(0)
+
+#else
+
+#define PROFILE_INSTR_BEGIN()
+#define PROFILE_INSTR_END()
+#define PROFILE_HALT_BEGIN()
+#define PROFILE_HALT_END()
+
+#endif
+
+#endif
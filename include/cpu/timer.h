@@ -4,11 +4,20 @@
 #include "defs.h"
 #include "type.h"
 
-typedef struct GB_timer_s GB_timer_t;
+#include <stdint.h>
 
-GB_timer_t* GB_timer_create();
-void        GB_timer_destroy(GB_timer_t *timer);
+typedef struct {
+    WORD        sysclk;
+    int         last_tima_inc_val;
+    int         tima_state;
+    uint64_t    last_sync;      // t_cycle_counter the timer has been brought up to
+} GB_timer_t;
+
+void        GB_timer_init(GB_timer_t *timer);
+/// Timer event: catches up then schedules the next TIMA overflow
 void        GB_timer_update(GB_gameboy_t *gb);
+/// Brings the timer up to t_cycle_counter, required before any access to its registers
+void        GB_timer_sync(GB_gameboy_t *gb);
 BYTE        GB_timer_write_check(GB_gameboy_t *gb, WORD addr, BYTE data);
 
 #endif
@@ -1,31 +1,36 @@
 #ifndef CPUDEF_H_
 #define CPUDEF_H_
 
-#define rA       (gb->cpu->af.b.h)
-#define rF       (gb->cpu->af.b.l)
-#define rB       (gb->cpu->bc.b.h)
-#define rC       (gb->cpu->bc.b.l)
-#define rD       (gb->cpu->de.b.h)
-#define rE       (gb->cpu->de.b.l)
-#define rH       (gb->cpu->hl.b.h)
-#define rL       (gb->cpu->hl.b.l)
-#define SPh      (gb->cpu->sp.b.h)
-#define SPl      (gb->cpu->sp.b.l)
-#define PCh      (gb->cpu->pc.b.h)
-#define PCl      (gb->cpu->pc.b.l)
-#define rW       (gb->cpu->wz.b.h)
-#define rZ       (gb->cpu->wz.b.l)
+/// Register file the macros below work on. Code running a batch of instructions on a local copy defines it first
+#ifndef GB_REGS
+#define GB_REGS (gb->state.cpu.regs)
+#endif
 
-#define PREV_IR (gb->cpu->prev_ir)
-#define IR      (gb->cpu->ir)
-#define rAF      (gb->cpu->af.w)
-#define rBC      (gb->cpu->bc.w)
-#define rDE      (gb->cpu->de.w)
-#define rHL      (gb->cpu->hl.w)
-#define SP      (gb->cpu->sp.w)
-#define PC      (gb->cpu->pc.w)
-#define WZ      (gb->cpu->wz.w)
+#define rA       (GB_REGS.af.b.h)
+#define rF       (GB_REGS.af.b.l)
+#define rB       (GB_REGS.bc.b.h)
+#define rC       (GB_REGS.bc.b.l)
+#define rD       (GB_REGS.de.b.h)
+#define rE       (GB_REGS.de.b.l)
+#define rH       (GB_REGS.hl.b.h)
+#define rL       (GB_REGS.hl.b.l)
+#define SPh      (GB_REGS.sp.b.h)
+#define SPl      (GB_REGS.sp.b.l)
+#define PCh      (GB_REGS.pc.b.h)
+#define PCl      (GB_REGS.pc.b.l)
+#define rW       (GB_REGS.wz.b.h)
+#define rZ       (GB_REGS.wz.b.l)
 
-#define _IME    (gb->cpu->IME)
+#define PREV_IR (gb->state.cpu.prev_ir)
+#define IR      (gb->state.cpu.ir)
+#define rAF      (GB_REGS.af.w)
+#define rBC      (GB_REGS.bc.w)
+#define rDE      (GB_REGS.de.w)
+#define rHL      (GB_REGS.hl.w)
+#define SP      (GB_REGS.sp.w)
+#define PC      (GB_REGS.pc.w)
+#define WZ      (GB_REGS.wz.w)
+
+#define _IME    (gb->state.cpu.IME)
 
 #endif
\ No newline at end of file
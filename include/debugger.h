@@ -0,0 +1,71 @@
+#ifndef GB_DEBUGGER_H_
+#define GB_DEBUGGER_H_
+
+#include "cpu/cpu.h"
+#include "defs.h"
+#include "type.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Breakpoints and watchpoints, one bit per address.
+ * Breakpoints are tested before every instruction while a debugger is attached (gb->debugger), execution
+ * then leaves the batched interpreter. Without one, nothing is tested at all.
+ * Watchpoints are folded into the page table: only the pages holding one go through a checking handler.
+*/
+
+#define GB_DEBUGGER_ROM_BANKS       (0x200)             // MBC5 maximum
+#define GB_DEBUGGER_BANK_SIZE       (0x4000)
+
+#define GB_WATCH_READ               (0x01)
+#define GB_WATCH_WRITE              (0x02)
+
+typedef enum {
+    GB_DEBUGGER_RUNNING,
+    GB_DEBUGGER_BREAKPOINT,                             // Stopped before the instruction at pc
+    GB_DEBUGGER_WATCH_READ,                             // Stopped after the instruction at pc
+    GB_DEBUGGER_WATCH_WRITE
+} GB_debugger_stop_t;
+
+typedef struct {
+    GB_debugger_stop_t  reason;
+    WORD                pc;                             // Address of the instruction
+    int                 bank;                           // ROM bank of pc, -1 outside ROM
+    WORD                addr;                           // Accessed address and value for watchpoints
+    BYTE                data;
+    GB_cpu_t            cpu;                            // Registers when stopping
+} GB_debugger_hit_t;
+
+typedef struct {
+    BYTE               *rom_breakpoints[GB_DEBUGGER_ROM_BANKS];    // 0000-7FFF per bank, allocated on first use
+    BYTE                breakpoints[0x8000 / 8];                    // 8000-FFFF
+    BYTE                watchpoints[0x10000];                       // GB_WATCH_* per address
+    int                 page_watchpoints[0x100];                    // Watched addresses per 256-byte page
+
+    WORD                pc;                             // Address of the instruction being run
+    int                 skip_breakpoint;                // Resuming from a breakpoint runs its instruction
+    GB_debugger_hit_t   hit;
+} GB_debugger_t;
+
+GB_debugger_t*  GB_debugger_create();
+void            GB_debugger_destroy(GB_debugger_t *debugger);
+
+/// Sets or clears the breakpoint at addr, in ROM bank bank for 0000-7FFF (ignored above). Returns 0 on success
+int             GB_debugger_set_breakpoint(GB_debugger_t *debugger, int bank, WORD addr, int enabled);
+/// Sets the GB_WATCH_* accesses to addr that stop execution, 0 clears them
+void            GB_debugger_set_watchpoint(GB_gameboy_t *gb, WORD addr, int access);
+
+/// Called before every instruction while attached. Returns 1 when execution must not go on
+int             GB_debugger_check(GB_gameboy_t *gb);
+/// Records a watched access, execution stops at the end of the instruction
+void            GB_debugger_watch_hit(GB_gameboy_t *gb, WORD addr, BYTE data, int access);
+/// Lets execution go on after a stop
+void            GB_debugger_resume(GB_debugger_t *debugger);
+
+/// Writes why execution stopped and the register state
+void            GB_debugger_report(const GB_debugger_t *debugger, FILE *f);
+
+#define GB_DEBUGGER_STOPPED(gb)     ( (gb)->debugger && (gb)->debugger->hit.reason != GB_DEBUGGER_RUNNING )
+
+#endif
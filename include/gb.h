@@ -3,26 +3,38 @@
 
 #include "cpu/cpu.h"
 #include "cartridge/cartridge.h"
+#include "graphics/lcd.h"
 #include "graphics/ppu.h"
+#include "debugger.h"
 #include "defs.h"
 #include "joypad.h"
+#include "state.h"
+
+#define GB_T_CYCLES_PER_SECOND  (4194304)
+#define GB_SAVE_FLUSH_PERIOD    (1)     // Default of save_flush_period
 
 struct GB_gameboy_s {
+    GB_state_t      state;          // Kept first so the block starts on the (aligned) allocation
+
     GB_cartridge_t  *cartridge;
-    GB_cpu_t        *cpu;
-    GB_ppu_t        *ppu;
     GB_mmu_t        *mmu;
+    GB_exec_t       *exec;
     GB_joypad_t     *joypad;
+    GB_LCD_t        *lcd;           // NULL when headless
+    GB_debugger_t   *debugger;      // NULL unless attached, see debugger.h
 
-    // Registers
-    BYTE    *wram;      // C000-DFFF
-    BYTE    *unusable;  // FEA0-FEFF
-    BYTE    *io_regs;   // FF00-FF7F
-    BYTE    *hram;      // FF80-FFFE
-    BYTE    ie;         // FFFF
+    int             scanline_renderer;  // Draws lines at once instead of through the pixel FIFO (see ppu.c)
+    int             frame_skip;         // Frames left undrawn after each drawn one, their timing stays exact
+
+    int             save_flush_period;  // Emulated seconds between two flushes of battery-backed RAM, 0 to only save on destroy
+    uint64_t        next_save_flush;    // t_cycle_counter from which GB_gameboy_run() flushes
 };
 
-GB_gameboy_t*   GB_gameboy_create(const char *rom_path, int headless);
+/// save_path: file keeping battery-backed RAM across runs (see GB_cartridge_save_path), NULL to leave it in memory
+GB_gameboy_t*   GB_gameboy_create(const char *rom_path, const char *save_path, int headless);
 void            GB_gameboy_destroy(GB_gameboy_t *gb);
 
+/// Runs up to count instructions (see GB_cpu_run_batch) then flushes battery-backed RAM once save_flush_period went by
+void            GB_gameboy_run(GB_gameboy_t *gb, int count);
+
 #endif
@@ -6,21 +6,73 @@
 #include "cpu/timer.h"
 #include "graphics/ppu.h"
 #include "joypad.h"
+#include "memmap.h"
+#include "mmu.h"
 
-#define INC_CYCLE() do {                                              															    \
-    gb->cpu->t_cycle_counter+=4;                                        															\
-    GB_dma_run(gb);                                                                                                                 \
-    GB_ppu_tick(gb, 4);                                                                                                             \
-    GB_timer_update(gb);                                               															    \
-    GB_joypad_update(gb);                                                                                                           \
-} while(0)
+/// Advances one M-cycle, running the components whose deadline is due (see scheduler.h).
+/// Being a function keeps the opcode handlers expanding INC_CYCLE() small
+static inline void GB_inc_cycle(GB_gameboy_t *gb) {
+    uint64_t t          = gb->state.cpu.t_cycle_counter += 4;
+    uint64_t *deadlines = gb->state.scheduler.deadlines;
+
+    if (t >= deadlines[GB_EVENT_DMA])       GB_dma_run(gb);
+    if (t >= deadlines[GB_EVENT_PPU])       GB_ppu_tick(gb, 4);
+    if (t >= deadlines[GB_EVENT_TIMER])     GB_timer_update(gb);
+    if (t >= deadlines[GB_EVENT_JOYPAD])    GB_joypad_update(gb);
+}
+
+#define INC_CYCLE() GB_inc_cycle(gb)
+
+/// Write from the CPU: outside HRAM it could see a block OAM DMA through a bus conflict, which then steps again
+static inline void GB_cpu_write(GB_gameboy_t *gb, WORD addr, BYTE data) {
+    if (gb->state.dma.is_bulk && addr < GB_HRAM_START_ADDR) GB_dma_sync(gb);
+    GB_mem_write(gb, addr, data);
+}
+
+/// Reads the opcode at pc (PC++), served by the block cache when pc lies in cached code
+static inline BYTE GB_fetch_opcode(GB_gameboy_t *gb, WORD pc) {
+    GB_exec_t  *exec    = gb->exec;
+    GB_block_t *block   = exec->block;
+
+    if (!block || exec->block_pos >= block->instr_count || block->instrs[exec->block_pos].pc != pc) {
+        block           = GB_block_cache_lookup(gb, pc);
+        exec->block     = block;
+        exec->block_pos = 0;
+    }
+
+    if (!block) {
+        exec->instr = NULL;
+        return GB_mem_read(gb, pc);
+    }
+
+    exec->instr = &block->instrs[exec->block_pos++];
+    return exec->instr->opcode;
+}
+
+/// Interrupt handling works on gb->state.cpu.regs, code running on a local register file defines these to copy it back and forth
+#ifndef GB_REGS_STORE
+#define GB_REGS_STORE()
+#define GB_REGS_LOAD()
+#endif
 
 #define FETCH_CYCLE() do {                                                                                                          \
     BYTE ir = IR, prev_ir = PREV_IR;                                                                                                \
     PREV_IR = IR;                                                                                                                   \
     INC_CYCLE();                                                                                                                    \
-    IR = GB_mem_read(gb, PC++);                                                                                                     \
-    GB_interrupt_handle(gb, ir, prev_ir);                                                                                           \
+    IR = GB_fetch_opcode(gb, PC++);                                                                                                 \
+    if (PENDING_INTERRUPTS()) {                                                                                                     \
+        GB_REGS_STORE();                                                                                                            \
+        GB_interrupt_handle(gb, ir, prev_ir);                                                                                       \
+        GB_REGS_LOAD();                                                                                                             \
+    }                                                                                                                               \
+} while(0)
+
+/// EI takes effect after the following instruction
+#define EI_DELAY_UPDATE() do {                                                                                                      \
+    if (gb->state.cpu.ei_delay) {                                                                                                   \
+        gb->state.cpu.ei_delay = 0;                                                                                                 \
+        _IME = 1;                                                                                                                   \
+    }                                                                                                                               \
 } while(0)
 
 #endif
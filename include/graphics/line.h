@@ -0,0 +1,30 @@
+#ifndef GB_LINE_H_
+#define GB_LINE_H_
+
+#include "type.h"
+
+/**
+ * Pixel kernels of the scanline renderer, working on whole lines of color ids (one byte per pixel).
+ * SSE2 builds process 16 pixels per step, other targets fall back to plain loops giving the same result.
+*/
+
+#define GB_LINE_WIDTH                   (160)
+
+/// Color id of pixel x (0 leftmost) in a decoded tile row, 2 bits per pixel with the leftmost on top
+#define GB_TILE_ROW_PIXEL(row, x)       ( ( (row) >> ( 14 - 2 * (x) ) ) & 3 )
+
+#define GB_OBJ_ATTR_BG_PRIORITY         (0x80)
+#define GB_OBJ_ATTR_PALETTE             (0x10)
+
+/// Expands count tile rows, as decoded in GB_ppu_t.tile_rows, to 8 color ids each
+void    GB_line_decode(const WORD *rows, int count, BYTE *ids);
+
+/**
+ * Mixes the background and object layers of a line and maps them through their palettes to shades 0-3.
+ * An object pixel shows when its color id isn't 0, unless its attributes give the background priority over it
+ * and the background color id isn't 0 either
+*/
+void    GB_line_compose(const BYTE *bg_ids, const BYTE *obj_ids, const BYTE *obj_attrs,
+                        BYTE bgp, BYTE obp0, BYTE obp1, BYTE *shades);
+
+#endif
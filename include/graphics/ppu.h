@@ -5,29 +5,108 @@
 #include "type.h"
 #include "lcd.h"
 
-typedef struct OAMBuffer OAMBuffer;
-typedef struct PixelFetcher PixelFetcher;
+#include <stdint.h>
+
+#define GB_VRAM_SIZE    (0x2000)
+#define GB_OAM_SIZE     (0x00A0)
+#define GB_TILE_ROWS    (0x0C00)                /* 384 tiles of 8 rows, 8000-97FF */
+
+/**
+ * 16 pixels held as shift registers, 2 bits per pixel with the next one out on top (the layout of tile_rows).
+ * Palette and priority bits are repeated over both bits of their pixel so one mask selects all three
+*/
+typedef struct {
+    DWORD color_ids;
+    DWORD palette_ids;
+    DWORD bg_priorities;
+    int size;
+} PixelFIFO;
+
+typedef struct {
+    BYTE buffer[10];
+    int buf_size;
+    int cur_oam_addr;
+} OAMBuffer;
 
 typedef struct {
-    BYTE            *vram;
-    BYTE            *oam;
+    int             x;
+    int             y;
+    int             status;
+    BYTE            tile_id;
+    WORD            tile_row;                   /* Decoded, see tile_rows */
+    PixelFIFO       fifo;
+
+    int             draw_window;
+    int             window_line_counter;
 
-    OAMBuffer       *oam_buffer;
-    PixelFetcher    *bg_fetcher;
-    PixelFetcher    *obj_fetcher;
+    int             sprite_addr;
+    int             sprite_tall_ly_start;
+    int             last_sprite_x_end;
+} PixelFetcher;
+
+/* LCD registers as the PPU reads them, decoded when the CPU writes them. STAT and LY are kept in io_regs */
+typedef struct {
+    BYTE            lcdc;
+    BYTE            scy;
+    BYTE            scx;
+    BYTE            lyc;
+    BYTE            bgp;
+    BYTE            obp[2];
+    BYTE            wy;
+    BYTE            wx;
+
+    BYTE            lcd_en;                     /* LCDC bits */
+    BYTE            win_en;
+    BYTE            obj_en;
+    BYTE            bg_en;                      /* BG and WIN enable */
+    BYTE            obj_height;                 /* 8 or 16 */
+    BYTE            signed_tiles;               /* Tile ids are signed offsets from tile_data */
+    WORD            tile_data;                  /* 8000 or 9000 */
+    WORD            bg_map;                     /* 9800 or 9C00 */
+    WORD            win_map;
+} GB_ppu_regs_t;
+
+/* Counters and registers first, then the fetchers, VRAM and OAM */
+typedef struct {
     int             fetch_obj;
     int             lx;                         /* Current scanline X coordinate */
     int             pending_cycles;
     int             scanline_dot_counter;
     int             m_ppu_mode_switched;
+    uint64_t        last_sync;                  /* t_cycle_counter the PPU has been brought up to */
+
+    int             fast_line;                  /* Whether the scanline renderer draws the current line */
+    int             fast_line_end;              /* Dot ending its Mode 3 */
+    int             fast_line_pending;          /* pending_cycles when its Mode 3 started, to replay it through the FIFO */
+    int             skip_frame;                 /* Whether the current frame is left undrawn, see frame_skip */
+    int             skipped_frames;             /* Undrawn in a row before the current one */
+
+    GB_ppu_regs_t   regs;
+
+    OAMBuffer       oam_buffer;
+    PixelFetcher    bg_fetcher;
+    PixelFetcher    obj_fetcher;
+
+    BYTE            vram[GB_VRAM_SIZE];
+    BYTE            oam[GB_OAM_SIZE];
 
-    GB_LCD_t        *lcd;
+    /* Tile data decoded to 2 bits per pixel, leftmost pixel on top. GB_ppu_vram_write keeps them up to date */
+    WORD            tile_rows[GB_TILE_ROWS];
+    WORD            tile_rows_flipped[GB_TILE_ROWS];    /* Same rows mirrored */
 } GB_ppu_t;
 
-GB_ppu_t*   GB_ppu_create(int headless);
-void        GB_ppu_destroy(GB_ppu_t *ppu);
+void        GB_ppu_init(GB_ppu_t *ppu);
 
 void        GB_ppu_tick(GB_gameboy_t *gb, int cycles);
+/// Brings the PPU up to t_cycle_counter, required before changing LCDC
+void        GB_ppu_sync(GB_gameboy_t *gb);
+/// Whether the PPU cannot read OAM within the next m_cycles, judged without syncing it
+int         GB_ppu_oam_idle(GB_gameboy_t *gb, int m_cycles);
+/**
+ * Must see every CPU write to the LCD registers but DMA, before it lands: the PPU catches up with the old value and a line
+ * left to the scanline renderer goes back to the FIFO, then the value gets decoded into regs
+*/
+void        GB_ppu_register_write(GB_gameboy_t *gb, WORD addr, BYTE data);
 
 BYTE        GB_ppu_vram_read(GB_ppu_t *ppu, WORD addr);
 void        GB_ppu_vram_write(GB_ppu_t *ppu, WORD addr, BYTE data);
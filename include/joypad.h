@@ -3,6 +3,7 @@
 
 #include "memmap.h"
 #include "cpu/interrupt.h"
+#include "scheduler.h"
 
 #include <SDL_keyboard.h>
 #include <SDL_scancode.h>
@@ -27,7 +28,7 @@ static inline void GB_joypad_destroy(GB_joypad_t *joypad) {
     if (joypad) free(joypad);
 }
 
-#define GB_P1                   ( gb->io_regs[GB_JOYP_ADDR&0xFF] )
+#define GB_P1                   ( gb->state.io_regs[GB_JOYP_ADDR&0xFF] )
 #define _GB_P1_SELECT_BUTTONS   ( GB_P1 & 0x20 )
 #define _GB_P1_SELECT_DPAD      ( GB_P1 & 0x10 )
 
@@ -39,7 +40,10 @@ static inline void GB_joypad_destroy(GB_joypad_t *joypad) {
     ( ( ( GB_P1 & 0x30 ) == 0x30 ) ? 0xF : ( GB_P1 & 0xF ) )    /* Buttons          */                          \
 )
 
-#define GB_joypad_write(gb, addr, data) do { GB_P1 = ( GB_P1 & (~0x30) ) | ( data & 0x30 );  } while(0)
+#define GB_joypad_write(gb, addr, data) do {                                                                   \
+    GB_P1 = ( GB_P1 & (~0x30) ) | ( data & 0x30 );                                                              \
+    GB_SCHEDULE_ASAP(gb, GB_EVENT_JOYPAD);                                                                      \
+} while(0)
 
 #define _GB_joypad_set_key(scancode, bit_pos)                                                                   \
     if (gb->joypad->kb_state[scancode]) {                                                                       \
@@ -59,9 +63,28 @@ static inline void GB_joypad_destroy(GB_joypad_t *joypad) {
     }                                                                                                           \
 } while (0)
 
+#define _GB_joypad_keys_held(target_selection_mode, k3, k2, k1, k0) (                                         \
+    !( _GB_P1_SELECT_##target_selection_mode ) && (                                                             \
+        gb->joypad->kb_state[k3] || gb->joypad->kb_state[k2] ||                                                 \
+        gb->joypad->kb_state[k1] || gb->joypad->kb_state[k0] )                                                  \
+)
+
+/**
+ * The keyboard state only changes on SDL polls and the selection on P1 writes, both schedule an update.
+ * While a selected key is held the update keeps running every M-cycle as it may request the interrupt again.
+*/
 #define GB_joypad_update(gb) do {                                                                               \
     _GB_joypad_update_keys(BUTTONS, SDL_SCANCODE_RSHIFT, SDL_SCANCODE_RETURN, SDL_SCANCODE_Q, SDL_SCANCODE_W);  \
     _GB_joypad_update_keys(DPAD, SDL_SCANCODE_DOWN, SDL_SCANCODE_UP, SDL_SCANCODE_LEFT, SDL_SCANCODE_RIGHT);    \
+    if ( _GB_joypad_keys_held(BUTTONS, SDL_SCANCODE_RSHIFT, SDL_SCANCODE_RETURN, SDL_SCANCODE_Q, SDL_SCANCODE_W) || \
+         _GB_joypad_keys_held(DPAD, SDL_SCANCODE_DOWN, SDL_SCANCODE_UP, SDL_SCANCODE_LEFT, SDL_SCANCODE_RIGHT) ) {  \
+        GB_SCHEDULE_IN(gb, GB_EVENT_JOYPAD, 1);                                                                 \
+    } else {                                                                                                    \
+        GB_UNSCHEDULE(gb, GB_EVENT_JOYPAD);                                                                     \
+    }                                                                                                           \
 } while (0)
 
+/// To be called once SDL events have been polled
+#define GB_joypad_poll(gb) GB_SCHEDULE_ASAP(gb, GB_EVENT_JOYPAD)
+
 #endif
@@ -39,6 +39,7 @@
 #define GB_SCX_ADDR                         (0xFF43)
 #define GB_WY_ADDR                          (0xFF4A)
 #define GB_WX_ADDR                          (0xFF4B)
+#define GB_DMA_ADDR                         (0xFF46)
 #define GB_BGP_ADDR                         (0xFF47)
 #define GB_OBP0_ADDR                        (0xFF48)
 #define GB_OBP1_ADDR                        (0xFF49)
@@ -48,6 +49,10 @@
 #define GB_ROM_END_ADDR                     (0x7FFF)
 #define GB_VRAM_START_ADDR                  (0x8000)
 #define GB_VRAM_END_ADDR                    (0x9FFF)
+#define GB_TILE_DATA_START_ADDR             (GB_VRAM_START_ADDR)
+#define GB_TILE_DATA_END_ADDR               (0x97FF)
+#define GB_TILE_MAPS_START_ADDR             (0x9800)
+#define GB_TILE_MAPS_END_ADDR               (GB_VRAM_END_ADDR)
 #define GB_EXT_RAM_START_ADDR               (0xA000)
 #define GB_EXT_RAM_END_ADDR                 (0xBFFF)
 #define GB_WRAM_START_ADDR                  (0xC000)
@@ -58,6 +63,8 @@
 #define GB_OAM_END_ADDR                     (0xFE9F)
 #define GB_UNUSABLE_START_ADDR              (0xFEA0)
 #define GB_UNUSABLE_END_ADDR                (0xFEFF)
+#define GB_IO_REGS_START_ADDR               (GB_JOYP_ADDR)
+#define GB_IO_REGS_END_ADDR                 (0xFF7F)
 #define GB_SERIAL_START_ADDR                (GB_SB_ADDR)
 #define GB_SERIAL_END_ADDR                  (GB_SC_ADDR)
 #define GB_TIMER_REGS_START_ADDR            (GB_DIV_ADDR)
@@ -71,4 +78,53 @@
 #define GB_HRAM_START_ADDR                  (0xFF80)
 #define GB_HRAM_END_ADDR                    (0xFFFE)
 
+/**
+ * DMG IO registers as X(addr, unused, read_only): unused bits (write-only ones included) read back as 1,
+ * CPU writes leave read-only bits alone. Wave pattern RAM is plain memory, other registers missing from the list
+ * read 0xFF and ignore writes
+*/
+#define GB_IO_REGS(X)                                       \
+    X(GB_JOYP_ADDR,                     0xC0,   0x0F)       \
+    X(GB_SB_ADDR,                       0x00,   0x00)       \
+    X(GB_SC_ADDR,                       0x7E,   0x00)       \
+    X(GB_DIV_ADDR,                      0x00,   0x00)       \
+    X(GB_TIMA_ADDR,                     0x00,   0x00)       \
+    X(GB_TMA_ADDR,                      0x00,   0x00)       \
+    X(GB_TAC_ADDR,                      0xF8,   0x00)       \
+    X(GB_IF_ADDR,                       0xE0,   0x00)       \
+    X(GB_NR10_ADDR,                     0x80,   0x00)       \
+    X(GB_NR11_ADDR,                     0x3F,   0x00)       \
+    X(GB_NR12_ADDR,                     0x00,   0x00)       \
+    X(GB_NR13_ADDR,                     0xFF,   0x00)       \
+    X(GB_NR14_ADDR,                     0xBF,   0x00)       \
+    X(GB_NR21_ADDR,                     0x3F,   0x00)       \
+    X(GB_NR22_ADDR,                     0x00,   0x00)       \
+    X(GB_NR23_ADDR,                     0xFF,   0x00)       \
+    X(GB_NR24_ADDR,                     0xBF,   0x00)       \
+    X(GB_NR30_ADDR,                     0x7F,   0x00)       \
+    X(GB_NR31_ADDR,                     0xFF,   0x00)       \
+    X(GB_NR32_ADDR,                     0x9F,   0x00)       \
+    X(GB_NR33_ADDR,                     0xFF,   0x00)       \
+    X(GB_NR34_ADDR,                     0xBF,   0x00)       \
+    X(GB_NR41_ADDR,                     0xFF,   0x00)       \
+    X(GB_NR42_ADDR,                     0x00,   0x00)       \
+    X(GB_NR43_ADDR,                     0x00,   0x00)       \
+    X(GB_NR44_ADDR,                     0xBF,   0x00)       \
+    X(GB_NR50_ADDR,                     0x00,   0x00)       \
+    X(GB_NR51_ADDR,                     0x00,   0x00)       \
+    X(GB_NR52_ADDR,                     0x70,   0x00)       /* Channel status stays writable, no APU to drive it */ \
+    X(GB_LCDC_ADDR,                     0x00,   0x00)       \
+    X(GB_STAT_ADDR,                     0x80,   0x07)       \
+    X(GB_SCY_ADDR,                      0x00,   0x00)       \
+    X(GB_SCX_ADDR,                      0x00,   0x00)       \
+    X(GB_LY_ADDR,                       0x00,   0xFF)       \
+    X(GB_LYC_ADDR,                      0x00,   0x00)       \
+    X(GB_DMA_ADDR,                      0x00,   0x00)       \
+    X(GB_BGP_ADDR,                      0x00,   0x00)       \
+    X(GB_OBP0_ADDR,                     0x00,   0x00)       \
+    X(GB_OBP1_ADDR,                     0x00,   0x00)       \
+    X(GB_WY_ADDR,                       0x00,   0x00)       \
+    X(GB_WX_ADDR,                       0x00,   0x00)       \
+    X(GB_BOOT_ROM_UNMAP_ADDR,           0xFE,   0x00)
+
 #endif
@@ -4,12 +4,37 @@
 #include "type.h"
 #include "defs.h"
 
+#include <stdint.h>
+
+#define GB_DMA_LENGTH       (0xA0)  // Bytes per transfer, one per M-cycle
+
+typedef struct {
+    int         state;
+    int         offset;
+    int         is_active;          // Whether dma is running regardless of its state
+    int         restart_cntdown;
+    WORD        source;
+
+    int         is_bulk;            // Copies the whole transfer on its last M-cycle instead of stepping
+    uint64_t    bulk_start;         // t_cycle_counter of the first byte
+
+    WORD        addr_bus;           // Used for DMA conflict
+    BYTE        data_bus;
+} GB_dma_t;
+
 BYTE        GB_mem_read(GB_gameboy_t *gb, WORD addr);
 void        GB_mem_write(GB_gameboy_t *gb, WORD addr, BYTE data);
 
 GB_mmu_t*   GB_mmu_create();
 void        GB_mmu_destroy(GB_mmu_t *mmu);
+/// Builds the page table, once every memory area is allocated
+void        GB_mmu_map(GB_gameboy_t *gb);
+/// Routes the accesses to the page holding addr through the debugger watchpoints, or back to its mapping
+void        GB_mmu_watch_page(GB_gameboy_t *gb, WORD addr, int watched);
 
+void        GB_dma_init(GB_dma_t *dma);
 void        GB_dma_run(GB_gameboy_t *gb);
+/// Copies the bytes of a block transfer due by now then steps the rest, before the CPU may observe them
+void        GB_dma_sync(GB_gameboy_t *gb);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef GB_SCHEDULER_H_
+#define GB_SCHEDULER_H_
+
+#include "type.h"
+
+#include <stdint.h>
+
+/**
+ * Components run on INC_CYCLE() only once t_cycle_counter reaches their deadline, in this order.
+ * Each component sets its next deadline when it runs, IO writes that wake a component up schedule it asap.
+*/
+enum GB_EVENT {
+    GB_EVENT_DMA,
+    GB_EVENT_PPU,
+    GB_EVENT_TIMER,
+    GB_EVENT_JOYPAD,
+    GB_EVENT_COUNT
+};
+
+#define GB_EVENT_NEVER              (UINT64_MAX)
+
+typedef struct {
+    uint64_t    deadlines[GB_EVENT_COUNT];      // t_cycle_counter value from which the component must run
+} GB_scheduler_t;
+
+#define GB_SCHEDULE(gb, event, t_cycle)     ( (gb)->state.scheduler.deadlines[event] = (t_cycle) )
+#define GB_SCHEDULE_ASAP(gb, event)         GB_SCHEDULE(gb, event, 0)                                   /* Next M-cycle */
+#define GB_SCHEDULE_IN(gb, event, m_cycles) GB_SCHEDULE(gb, event, (gb)->state.cpu.t_cycle_counter + 4 * (uint64_t)(m_cycles))
+#define GB_UNSCHEDULE(gb, event)            GB_SCHEDULE(gb, event, GB_EVENT_NEVER)
+
+/// Earliest deadline among all components
+static inline uint64_t GB_scheduler_next(const GB_scheduler_t *scheduler) {
+    uint64_t next = GB_EVENT_NEVER;
+
+    for (int i = 0; i < GB_EVENT_COUNT; i++) {
+        if (scheduler->deadlines[i] < next) next = scheduler->deadlines[i];
+    }
+
+    return next;
+}
+
+#endif
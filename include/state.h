@@ -0,0 +1,44 @@
+#ifndef GB_STATE_H_
+#define GB_STATE_H_
+
+#include "cpu/cpu.h"
+#include "graphics/ppu.h"
+#include "mmu.h"
+#include "scheduler.h"
+#include "type.h"
+
+#define GB_CACHE_LINE_SIZE  (64)
+
+#if defined(__GNUC__) || defined(__clang__)
+#define GB_CACHE_ALIGNED    __attribute__((aligned(GB_CACHE_LINE_SIZE)))
+#else
+#define GB_CACHE_ALIGNED
+#endif
+
+#define GB_WRAM_SIZE        (0x2000)
+#define GB_UNUSABLE_SIZE    (0x0060)
+#define GB_IO_REGS_SIZE     (0x0080)
+#define GB_HRAM_SIZE        (0x007F)
+
+/**
+ * Mutable state of the console itself in one block free of pointers, copying it moves CPU, timer, PPU, DMA and memory at once.
+ * Groups touched together start on their own cache line, the ones every M-cycle needs first.
+ * The cartridge (MBC registers, external RAM) lives outside and has to be saved alongside for a full snapshot,
+ * as does the host-side data derived from both (page table, block cache) that must be rebuilt after a restore.
+*/
+typedef struct {
+    GB_scheduler_t  scheduler           GB_CACHE_ALIGNED;
+    GB_cpu_t        cpu;                                    // Registers, lazy flags, cycle counter and timer
+
+    BYTE            io_regs[GB_IO_REGS_SIZE] GB_CACHE_ALIGNED; // FF00-FF7F
+    BYTE            hram[GB_HRAM_SIZE];                     // FF80-FFFE
+    BYTE            ie;                                     // FFFF
+    GB_dma_t        dma;
+
+    GB_ppu_t        ppu                 GB_CACHE_ALIGNED;   // VRAM and OAM included
+
+    BYTE            wram[GB_WRAM_SIZE]  GB_CACHE_ALIGNED;   // C000-DFFF
+    BYTE            unusable[GB_UNUSABLE_SIZE];             // FEA0-FEFF
+} GB_state_t;
+
+#endif
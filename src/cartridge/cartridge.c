@@ -1,5 +1,6 @@
 #include "cartridge/cartridge.h"
 #include "cartridge/mbc.h"
+#include "cartridge/rom.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,7 +10,7 @@
 
 #define ROM_SIZE(header) ( (32 * 1024UL) * ( 1 << header->rom_type ) )
 
-GB_header_t* GB_header_create(FILE *fp, long fsize) {
+GB_header_t* GB_header_create(const BYTE *rom, size_t fsize) {
 	GB_header_t *header;
 
 	if (fsize < 0x150) {
@@ -21,24 +22,31 @@ GB_header_t* GB_header_create(FILE *fp, long fsize) {
 		return NULL;
 	}
    
-	fseek(fp, 0x134, SEEK_SET);
-
-	int rv = fread((void*)header, HEADER_SIZE_IN_BYTES, 1, fp);
-
-	if (rv != 1) {
-		fprintf(stderr, "FAIL READ BUFFER\n");
+	memcpy((void*)header, rom + 0x134, HEADER_SIZE_IN_BYTES);
 
+	if (fsize != ROM_SIZE(header)) {
+		fprintf(stderr, "ROM SIZE(%lu) doesn't match file size(%lu)\n", ROM_SIZE(header), (unsigned long)fsize);
 		free(header);
 		return NULL;
 	}
 
-	if (fsize != ROM_SIZE(header)) {
-		fprintf(stderr, "ROM SIZE(%lu) doesn't match file size(%lu)\n", ROM_SIZE(header), fsize);
-		free(header);
+	return header;
+}
+
+char* GB_cartridge_save_path(const char *rom_path) {
+	const char *slash 	= strrchr(rom_path, '/');
+	const char *dot 	= strrchr(rom_path, '.');
+	size_t len 			= ( dot && (!slash || dot > slash) ) ? (size_t)(dot - rom_path) : strlen(rom_path);
+
+	char *path = (char*)( malloc( len + sizeof ".sav" ) );
+	if (!path) {
 		return NULL;
 	}
 
-	return header;
+	memcpy(path, rom_path, len);
+	strcpy(path + len, ".sav");
+
+	return path;
 }
 
 void GB_header_destroy(GB_header_t *header) {
@@ -69,51 +77,47 @@ void GB_print_header(GB_header_t *header) {
 			header->global_checksum );
 }
 
-GB_cartridge_t* GB_cartridge_create(const char *path) {
+GB_cartridge_t* GB_cartridge_create(const char *path, const char *save_path) {
 	GB_cartridge_t *cartridge;
-    FILE *fp;
-	long fsize;
 
 	cartridge = (GB_cartridge_t*)( malloc( sizeof (GB_cartridge_t) ) );
 	if (!cartridge) { return NULL; }
 
 	cartridge->header 	= NULL;
 	cartridge->mbc 		= NULL;
+	cartridge->rom_size = 0;
 	
-	fp = fopen(path, "rb");
-    if (!fp) { 
+	cartridge->rom = GB_rom_map(path, &cartridge->rom_size);
+    if (!cartridge->rom) { 
 		GB_cartridge_destroy(cartridge);
 		return NULL; 
 	}
 
-    fseek(fp, 0, SEEK_END);
-    fsize = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-
-	cartridge->header = GB_header_create(fp, fsize);
+	cartridge->header = GB_header_create(cartridge->rom, cartridge->rom_size);
 
 	if (!cartridge->header) {
-        fclose(fp);
 		GB_cartridge_destroy(cartridge);
 		return NULL;
 	}
 
-	cartridge->mbc = GB_mbc_create(cartridge->header, fp, fsize);
+	cartridge->mbc = GB_mbc_create(cartridge->header, cartridge->rom, cartridge->rom_size, save_path);
 	if (!cartridge->mbc) {
-        fclose(fp);
 		GB_cartridge_destroy(cartridge);
 		return NULL;
 	}
-    
-    fclose(fp);
 
     return cartridge;
 }
 
+void GB_cartridge_flush(GB_cartridge_t *cartridge) {
+	GB_mbc_flush(cartridge->mbc);
+}
+
 void GB_cartridge_destroy(GB_cartridge_t *cartridge) {
 	if (!cartridge) return;
     GB_mbc_destroy(cartridge->mbc);
 	GB_header_destroy(cartridge->header);
+	GB_rom_unmap(cartridge->rom);
 
 	free(cartridge);
 }
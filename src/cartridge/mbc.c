@@ -1,4 +1,5 @@
 #include "cartridge/mbc.h"
+#include "cartridge/save.h"
 #include "defs.h"
 
 #include <stdint.h>
@@ -16,20 +17,11 @@
 #define _rom_size           ( mbc->rom_size )
 #define _ram_size           ( mbc->ram_size )
 
-#define CHECK_BOUNDERIES(a, b, src_addr, real_addr, msg, rv) do {                   \
-    if (real_addr < a || real_addr >= b) {                                          \
-        fprintf(stderr,                                                             \
-                "OUT OF RANGE %s BANK%d ($%04X => $%lX)\n",                         \
-                msg,                                                                \
-                ROM_BANK_NUMBER,                                                    \
-                src_addr,                                                           \
-                (unsigned long)real_addr);                                          \
-        return rv;                                                                  \
-    }                                                                               \
-} while(0)
+#define ROM_BANK_SIZE       (0x4000)
+#define RAM_BANK_SIZE       (0x2000)
 
-typedef BYTE (*mbc_read_callback)(GB_mbc_t *mbc, WORD addr);
 typedef void (*mbc_write_callback)(GB_mbc_t *mbc, WORD addr, BYTE data);
+typedef void (*mbc_remap_callback)(GB_mbc_t *mbc);
 
 struct GB_mbc_s {
     WORD                rom_bank_number;
@@ -40,100 +32,106 @@ struct GB_mbc_s {
     int                 rom_bank_count;
     int                 ram_bank_count;
 
-	BYTE                *rom;
+	const BYTE          *rom;               // Shared mapping owned by the cartridge
 	BYTE                *ram;
+	GB_save_t           *save;              // Backs ram with the save file on battery cartridges given one, NULL otherwise
 	size_t              rom_size;
 	size_t              ram_size;
 
-    mbc_read_callback   read_callback;
+    // Mapping resolved by remap_callback whenever a bank register changes
+    int                 rom0_bank;          // Bank mapped at 0000-3FFF
+    int                 romx_bank;          // Bank mapped at 4000-7FFF
+    const BYTE          *rom0_base;         // NULL when the bank lies out of the ROM file
+    const BYTE          *romx_base;
+    BYTE                *ram_base;          // NULL when RAM is disabled or out of range
+    WORD                ram_mask;           // Offset mask within A000-BFFF (MBC2 RAM is mirrored)
+
     mbc_write_callback  write_callback;
+    mbc_remap_callback  remap_callback;
 };
 
-#define RETURN_FROM_ROM(real_addr)                                                  \
-    CHECK_BOUNDERIES(0, _rom_size, addr, (real_addr), "READ ROM", 0xFF);            \
-    return mbc->rom[real_addr]
-
-#define RETURN_FROM_RAM(real_addr)                                                  \
-    CHECK_BOUNDERIES(0, _ram_size, addr, (real_addr), "READ RAM", 0xFF);            \
-    return mbc->ram[real_addr]
-
-#define ACCESS_RAM(real_addr)                                                       \
-    CHECK_BOUNDERIES(0, _ram_size, addr, (real_addr), "WRITE RAM", );               \
-    mbc->ram[real_addr]
-
-#define GB_MBC_READ_TEMPLATE(n, ramb_addr_expr)                                     \
-    BYTE GB_mbc##n##_read(GB_mbc_t *mbc, WORD addr) {                               \
-        if (addr < 0x4000) {                                                        \
-            RETURN_FROM_ROM(addr);                                                  \
-        } else if (addr < 0x8000) {                                                 \
-            RETURN_FROM_ROM(0x4000 * ROM_BANK_NUMBER + (addr - 0x4000));            \
-        } else if (addr > 0x9FFF && addr < 0xC000 && RAM_ENABLED) {                 \
-            RETURN_FROM_RAM(ramb_addr_expr);                                        \
-        }                                                                           \
-        return 0xFF;                                                                \
+const BYTE* rom_bank_base(GB_mbc_t *mbc, int bank) {
+    if ((size_t)(bank + 1) * ROM_BANK_SIZE > _rom_size) {
+        fprintf(stderr, "OUT OF RANGE ROM BANK%d ($%lX BYTES)\n", bank, (unsigned long)_rom_size);
+        return NULL;
     }
 
-GB_MBC_READ_TEMPLATE(0, (addr&0x1fff))
+    return mbc->rom + bank * ROM_BANK_SIZE;
+}
 
-void GB_mbc0_write(GB_mbc_t *mbc, WORD addr, BYTE data) {
-    if (addr > 0x9FFF && addr < 0xC000 && RAM_ENABLED) {
-        ACCESS_RAM(addr&0x1fff) = data;
+BYTE* ram_bank_base(GB_mbc_t *mbc, int bank) {
+    if (!RAM_ENABLED) {
+        return NULL;
+    }
+
+    if ((size_t)(bank + 1) * RAM_BANK_SIZE > _ram_size) {
+        fprintf(stderr, "OUT OF RANGE RAM BANK%d ($%lX BYTES)\n", bank, (unsigned long)_ram_size);
+        return NULL;
     }
+
+    return mbc->ram + bank * RAM_BANK_SIZE;
 }
 
-#define MBC1_RAM_ADDR() ( ( (BANKING_MODE & RAM_BANK_NUMBER) << 13 ) | (addr & 0x1fff) )
-
-BYTE GB_mbc1_read(GB_mbc_t *mbc, WORD addr) {
-    /**
-     * ┌────────────────────────────┬─────────────────────────────────────────┐
-     * │                            │              ROM address bits           │
-     * │     Accessed address       │    Bank number    │ Address within bank │
-     * ├────────────────────────────┼─────────┬─────────┼─────────────────────┤
-     * │                            │  20─19  │  18─14  │       13─0          │
-     * ├────────────────────────────┼─────────┼─────────┼─────────────────────┤
-     * │ 0x0000─0x3FFF, MODE = 0b0  │  0b00   │ 0b00000 │     A<13:0>         │
-     * ├────────────────────────────┼─────────┼─────────┼─────────────────────┤
-     * │ 0x0000─0x3FFF, MODE = 0b1  │  BANK2  │ 0b00000 │     A<13:0>         │
-     * ├────────────────────────────┼─────────┼─────────┼─────────────────────┤
-     * │        0x4000─0x7FFF       │  BANK2  │ BANK1   │     A<13:0>         │
-     * └────────────────────────────┴─────────┴─────────┴─────────────────────┘
-     */
-
-    /**
-     * ┌────────────────────────────┬─────────────────────────────────────────┐
-     * │                            │              RAM address bits           │
-     * │     Accessed address       │    Bank number    │ Address within bank │
-     * ├────────────────────────────┼───────────────────┼─────────────────────┤
-     * │                            │       14-13       │       12─0          │
-     * ├────────────────────────────┼───────────────────┼─────────────────────┤
-     * │ 0x0000─0x3FFF, MODE = 0b0  │        0b00       │     A<12:0>         │
-     * ├────────────────────────────┼───────────────────┼─────────────────────┤
-     * │ 0x0000─0x3FFF, MODE = 0b1  │       BANK2       │     A<12:0>         │
-     * └────────────────────────────┴───────────────────┴─────────────────────┘
-     */
-    
-    uint64_t phys_addr = addr;
-
-    if (addr < 0x4000) {                                                // ROM Bank 00
-        phys_addr += 0x4000 * (((mbc->ram_bank_number << 5) & BANKING_MODE) & ROM_BANK_MASK);
-
-        RETURN_FROM_ROM(phys_addr);
-    } else if (addr < 0x8000) {                                         // ROM Bank 01-7F
-        phys_addr = 0x4000 * (((mbc->ram_bank_number << 5) | ROM_BANK_NUMBER) & ROM_BANK_MASK) + (addr - 0x4000);
-
-        RETURN_FROM_ROM(phys_addr);
-    } else if (addr > 0x9FFF && addr < 0xC000 && RAM_ENABLED) {         // RAM Bank 00-03
-        phys_addr = MBC1_RAM_ADDR();
-
-        RETURN_FROM_RAM(phys_addr);
+#define GB_MBC_REMAP_TEMPLATE(n, rom0_bank_expr, romx_bank_expr, ram_bank_expr, ram_mask_expr)                          \
+    void GB_mbc##n##_remap(GB_mbc_t *mbc) {                                                                             \
+        mbc->rom0_bank  = (rom0_bank_expr);                                                                             \
+        mbc->romx_bank  = (romx_bank_expr);                                                                             \
+        mbc->rom0_base  = rom_bank_base(mbc, mbc->rom0_bank);                                                           \
+        mbc->romx_base  = rom_bank_base(mbc, mbc->romx_bank);                                                           \
+        mbc->ram_base   = ram_bank_base(mbc, (ram_bank_expr));                                                          \
+        mbc->ram_mask   = (ram_mask_expr);                                                                              \
     }
 
-    return 0xFF;
+#define WRITE_RAM(data) do {                                                        \
+    if (mbc->ram_base) {                                                            \
+        size_t offset = (mbc->ram_base - mbc->ram) + (addr & mbc->ram_mask);        \
+        mbc->ram[offset] = (data);                                                  \
+        if (mbc->save) GB_SAVE_MARK_DIRTY(mbc->save, offset);                       \
+    }                                                                               \
+} while(0)
+
+GB_MBC_REMAP_TEMPLATE(0, 0, ROM_BANK_NUMBER, 0, 0x1fff)
+
+void GB_mbc0_write(GB_mbc_t *mbc, WORD addr, BYTE data) {
+    if (addr > 0x9FFF && addr < 0xC000) {
+        WRITE_RAM(data);
+    }
 }
 
-void GB_mbc1_write(GB_mbc_t *mbc, WORD addr, BYTE data) {
-    uint64_t phys_addr = addr;
+/**
+ * ┌────────────────────────────┬─────────────────────────────────────────┐
+ * │                            │              ROM address bits           │
+ * │     Accessed address       │    Bank number    │ Address within bank │
+ * ├────────────────────────────┼─────────┬─────────┼─────────────────────┤
+ * │                            │  20─19  │  18─14  │       13─0          │
+ * ├────────────────────────────┼─────────┼─────────┼─────────────────────┤
+ * │ 0x0000─0x3FFF, MODE = 0b0  │  0b00   │ 0b00000 │     A<13:0>         │
+ * ├────────────────────────────┼─────────┼─────────┼─────────────────────┤
+ * │ 0x0000─0x3FFF, MODE = 0b1  │  BANK2  │ 0b00000 │     A<13:0>         │
+ * ├────────────────────────────┼─────────┼─────────┼─────────────────────┤
+ * │        0x4000─0x7FFF       │  BANK2  │ BANK1   │     A<13:0>         │
+ * └────────────────────────────┴─────────┴─────────┴─────────────────────┘
+ */
+
+/**
+ * ┌────────────────────────────┬─────────────────────────────────────────┐
+ * │                            │              RAM address bits           │
+ * │     Accessed address       │    Bank number    │ Address within bank │
+ * ├────────────────────────────┼───────────────────┼─────────────────────┤
+ * │                            │       14-13       │       12─0          │
+ * ├────────────────────────────┼───────────────────┼─────────────────────┤
+ * │ 0x0000─0x3FFF, MODE = 0b0  │        0b00       │     A<12:0>         │
+ * ├────────────────────────────┼───────────────────┼─────────────────────┤
+ * │ 0x0000─0x3FFF, MODE = 0b1  │       BANK2       │     A<12:0>         │
+ * └────────────────────────────┴───────────────────┴─────────────────────┘
+ */
+GB_MBC_REMAP_TEMPLATE(1,
+                      ((mbc->ram_bank_number << 5) & BANKING_MODE) & ROM_BANK_MASK,
+                      ((mbc->ram_bank_number << 5) | ROM_BANK_NUMBER) & ROM_BANK_MASK,
+                      BANKING_MODE & RAM_BANK_NUMBER,
+                      0x1fff)
 
+void GB_mbc1_write(GB_mbc_t *mbc, WORD addr, BYTE data) {
     if (addr < 0x2000) {                                                    // RAM Enable
         mbc->ram_enabled = ( (data&0xF) == 0xA );
     } else if (addr < 0x4000) {                                             // ROM Bank Number
@@ -145,14 +143,12 @@ void GB_mbc1_write(GB_mbc_t *mbc, WORD addr, BYTE data) {
         mbc->banking_mode = (data&1) ? ~((int)0) : 0;
     }
 
-    if (addr > 0x9FFF && addr < 0xC000 && RAM_ENABLED) {                    // RAM Bank 00-03
-        phys_addr = MBC1_RAM_ADDR();
-
-        ACCESS_RAM(phys_addr) = data;
+    if (addr > 0x9FFF && addr < 0xC000) {                                   // RAM Bank 00-03
+        WRITE_RAM(data);
     }
 }
 
-GB_MBC_READ_TEMPLATE(2, (addr&0x1ff))
+GB_MBC_REMAP_TEMPLATE(2, 0, ROM_BANK_NUMBER, 0, 0x1ff)
 
 void GB_mbc2_write(GB_mbc_t *mbc, WORD addr, BYTE data) {
     if (addr < 0x4000) {
@@ -163,12 +159,12 @@ void GB_mbc2_write(GB_mbc_t *mbc, WORD addr, BYTE data) {
         }
     }
 
-    else if (addr >= 0xA000 && addr < 0xC000 && RAM_ENABLED) {
-        ACCESS_RAM(addr&0x1ff) = 0xF0 | (data&0xF);
+    else if (addr >= 0xA000 && addr < 0xC000) {
+        WRITE_RAM(0xF0 | (data&0xF));
     }
 }
 
-GB_MBC_READ_TEMPLATE(5, (0x2000 * RAM_BANK_NUMBER + (addr - 0xA000)))
+GB_MBC_REMAP_TEMPLATE(5, 0, ROM_BANK_NUMBER, RAM_BANK_NUMBER, 0x1fff)
 
 void GB_mbc5_write(GB_mbc_t *mbc, WORD addr, BYTE data) {
     if (addr < 0x2000) {
@@ -181,38 +177,53 @@ void GB_mbc5_write(GB_mbc_t *mbc, WORD addr, BYTE data) {
         mbc->ram_bank_number = ((data & 0x0F) & RAM_BANK_MASK);
     }
 
-    else if (addr >= 0xA000 && addr < 0xC000 && RAM_ENABLED) {
-        ACCESS_RAM(0x2000 * mbc->ram_bank_number + (addr - 0xA000)) = data;
+    else if (addr >= 0xA000 && addr < 0xC000) {
+        WRITE_RAM(data);
     }
 }
 
 BYTE GB_mbc_read(GB_mbc_t *mbc, WORD addr) {
-    return mbc->read_callback(mbc, addr);
+    if (addr < 0x4000) {
+        return mbc->rom0_base ? mbc->rom0_base[addr] : 0xFF;
+    } else if (addr < 0x8000) {
+        return mbc->romx_base ? mbc->romx_base[addr - 0x4000] : 0xFF;
+    } else if (addr > 0x9FFF && addr < 0xC000 && mbc->ram_base) {
+        return mbc->ram_base[addr & mbc->ram_mask];
+    }
+
+    return 0xFF;
 }
 
 void GB_mbc_write(GB_mbc_t *mbc, WORD addr, BYTE data) {
     mbc->write_callback(mbc, addr, data);
-}
 
-/*=================== INIT ===================*/
+    if (addr <= 0x7FFF) {
+        mbc->remap_callback(mbc);
+    }
+}
 
-int load_rom(GB_mbc_t *mbc, FILE *fp, long file_size) {
-    rewind(fp);
+void GB_mbc_flush(GB_mbc_t *mbc) {
+    if (mbc->save) GB_save_flush(mbc->save, 0);
+}
 
-    mbc->rom_size = file_size; 
-	mbc->rom = (BYTE*)( malloc( sizeof (BYTE) * mbc->rom_size + 1 ) );
-	if (!mbc->rom) {
-		return 1;
-	}
+int GB_mbc_rom_bank(GB_mbc_t *mbc, WORD addr) {
+    return (addr < 0x4000) ? mbc->rom0_bank : mbc->romx_bank;
+}
 
-    int rv = fread((void*)(mbc->rom), sizeof(BYTE), mbc->rom_size, fp);
-	if (rv != mbc->rom_size) {
-		return 2;
-	}
+const BYTE* GB_mbc_base(GB_mbc_t *mbc, WORD addr) {
+    if (addr < 0x4000) {
+        return mbc->rom0_base;
+    } else if (addr < 0x8000) {
+        return mbc->romx_base;
+    } else if (addr > 0x9FFF && addr < 0xC000 && mbc->ram_mask == 0x1fff) {
+        return mbc->ram_base;
+    }
 
-    return 0;
+    return NULL;
 }
 
+/*=================== INIT ===================*/
+
 #define FAIL_IF(cond)                                                                           \
     if (cond) { GB_mbc_destroy(mbc); return NULL; }
 
@@ -230,8 +241,10 @@ int load_rom(GB_mbc_t *mbc, FILE *fp, long file_size) {
 } while (0)
 
 #define SET_MBC_CALLBACKS(n) 							                                        \
-	mbc->read_callback 	= GB_mbc##n##_read;		                                                \
-	mbc->write_callback = GB_mbc##n##_write;
+	mbc->write_callback = GB_mbc##n##_write;                                                \
+	mbc->remap_callback = GB_mbc##n##_remap;
+
+#define HAS_BATTERY(cartridge_type) ( cartridge_type == 0x03 || cartridge_type == 0x06 || cartridge_type == 0x09 || cartridge_type == 0x1B || cartridge_type == 0x1E )
 
 #define SETUP_RW() do {                                                                         \
 	switch(header->cartridge_type) {                                                            \
@@ -258,7 +271,7 @@ int load_rom(GB_mbc_t *mbc, FILE *fp, long file_size) {
 	}                                                                                           \
 } while (0)
 
-GB_mbc_t* GB_mbc_create(GB_header_t *header, FILE *rom_fp, long file_size) {
+GB_mbc_t* GB_mbc_create(GB_header_t *header, const BYTE *rom, size_t rom_size, const char *save_path) {
     GB_mbc_t *mbc = NULL;
 
     if (header->rom_type > 8) {
@@ -276,30 +289,43 @@ GB_mbc_t* GB_mbc_create(GB_header_t *header, FILE *rom_fp, long file_size) {
     mbc->banking_mode       = 0;
     mbc->ram_enabled        = 0;
     mbc->rom_bank_count     = (2 << header->rom_type);
-    mbc->rom                = NULL;
-    mbc->rom_size           = 0;
+    mbc->rom                = rom;
+    mbc->rom_size           = rom_size;
     mbc->ram                = NULL;
+    mbc->save               = NULL;
     mbc->ram_size           = 0;
 
-    FAIL_IF(load_rom(mbc, rom_fp, file_size)) 
-
     SET_RAM_BANK_COUNT();
     SETUP_RW();
 
 	mbc->ram_size = 8192UL * mbc->ram_bank_count;
-	if (mbc->ram_size) {
+	if (mbc->ram_size && save_path && HAS_BATTERY(header->cartridge_type)) {
+		mbc->save = GB_save_create(save_path, mbc->ram_size);
+		if (mbc->save) {
+			mbc->ram = mbc->save->data;
+		} else {
+			fprintf(stderr, "RAM WON'T BE SAVED\n");
+		}
+	}
+
+	if (mbc->ram_size && !mbc->ram) {
 		mbc->ram = (BYTE*)( malloc( sizeof (BYTE) * mbc->ram_size + 1 ) );
 		FAIL_IF(!mbc->ram)
 	}
 
+    mbc->remap_callback(mbc);
+
     return mbc;
 }
 
 void GB_mbc_destroy(GB_mbc_t *mbc) {
     if (!mbc) return;
 
-	if (mbc->ram) free(mbc->ram);
-	if (mbc->rom) free(mbc->rom);
+	if (mbc->save) {
+		GB_save_destroy(mbc->save);
+	} else if (mbc->ram) {
+		free(mbc->ram);
+	}
 
     mbc->ram = NULL;
     mbc->rom = NULL;
@@ -0,0 +1,108 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "cartridge/rom.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef struct GB_rom_entry_s {
+    dev_t                   dev;            // Identifies the file whatever the path used to open it
+    ino_t                   ino;
+    BYTE                    *data;
+    size_t                  size;
+    int                     refcount;
+    struct GB_rom_entry_s   *next;
+} GB_rom_entry_t;
+
+static GB_rom_entry_t   *registry = NULL;
+static pthread_mutex_t  registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static GB_rom_entry_t* registry_find(dev_t dev, ino_t ino) {
+    for (GB_rom_entry_t *entry = registry; entry; entry = entry->next) {
+        if (entry->dev == dev && entry->ino == ino) return entry;
+    }
+
+    return NULL;
+}
+
+static GB_rom_entry_t* registry_add(int fd, const struct stat *st) {
+    GB_rom_entry_t *entry = (GB_rom_entry_t*)( malloc( sizeof (GB_rom_entry_t) ) );
+    if (!entry) {
+        return NULL;
+    }
+
+    entry->data = (BYTE*)( mmap(NULL, st->st_size, PROT_READ, MAP_PRIVATE, fd, 0) );
+    if (entry->data == MAP_FAILED) {
+        fprintf(stderr, "CANNOT MAP ROM\n");
+        free(entry);
+        return NULL;
+    }
+
+    entry->dev      = st->st_dev;
+    entry->ino      = st->st_ino;
+    entry->size     = st->st_size;
+    entry->refcount = 0;
+    entry->next     = registry;
+    registry        = entry;
+
+    return entry;
+}
+
+const BYTE* GB_rom_map(const char *path, size_t *size) {
+    GB_rom_entry_t *entry = NULL;
+    struct stat st;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "CANNOT OPEN %s\n", path);
+        return NULL;
+    }
+
+    if (fstat(fd, &st) || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&registry_lock);
+
+    entry = registry_find(st.st_dev, st.st_ino);
+    if (!entry) {
+        entry = registry_add(fd, &st);
+    }
+
+    if (entry) {
+        entry->refcount++;
+        *size = entry->size;
+    }
+
+    pthread_mutex_unlock(&registry_lock);
+    close(fd); // The mapping outlives the descriptor
+
+    return entry ? entry->data : NULL;
+}
+
+void GB_rom_unmap(const BYTE *rom) {
+    if (!rom) return;
+
+    pthread_mutex_lock(&registry_lock);
+
+    for (GB_rom_entry_t **link = &registry; *link; link = &(*link)->next) {
+        GB_rom_entry_t *entry = *link;
+
+        if (entry->data != rom) continue;
+
+        if (--entry->refcount == 0) {
+            *link = entry->next;
+            munmap(entry->data, entry->size);
+            free(entry);
+        }
+        break;
+    }
+
+    pthread_mutex_unlock(&registry_lock);
+}
@@ -0,0 +1,112 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE /* flock */
+
+#include "cartridge/save.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define PAGE_COUNT(save)        ( ( (save)->size + ( (size_t)1 << (save)->page_shift ) - 1 ) >> (save)->page_shift )
+#define IS_DIRTY(save, page)    ( (save)->dirty[(page) >> 3] & ( 1 << ((page) & 7) ) )
+
+GB_save_t* GB_save_create(const char *path, size_t size) {
+    struct stat st;
+    long page_size = sysconf(_SC_PAGESIZE);
+
+    GB_save_t *save = (GB_save_t*)( malloc( sizeof (GB_save_t) ) );
+    if (!save) {
+        return NULL;
+    }
+
+    save->data          = MAP_FAILED;
+    save->size          = size;
+    save->page_shift    = 0;
+    save->dirty         = NULL;
+
+    while (page_size > 1) {
+        page_size >>= 1;
+        save->page_shift++;
+    }
+
+    save->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (save->fd < 0) {
+        fprintf(stderr, "CANNOT OPEN SAVE FILE %s\n", path);
+        GB_save_destroy(save);
+        return NULL;
+    }
+
+    // Another instance running the same game owns the file, the released lock goes with close()
+    if (flock(save->fd, LOCK_EX | LOCK_NB)) {
+        fprintf(stderr, "SAVE FILE %s IS IN USE\n", path);
+        GB_save_destroy(save);
+        return NULL;
+    }
+
+    if (fstat(save->fd, &st) || ( (size_t)st.st_size < size && ftruncate(save->fd, size) )) {
+        fprintf(stderr, "CANNOT OPEN SAVE FILE %s\n", path);
+        GB_save_destroy(save);
+        return NULL;
+    }
+
+    save->data = (BYTE*)( mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, save->fd, 0) );
+    save->dirty = (BYTE*)( calloc( (PAGE_COUNT(save) + 7) / 8, sizeof (BYTE) ) );
+    if (save->data == MAP_FAILED || !save->dirty) {
+        fprintf(stderr, "CANNOT MAP SAVE FILE %s\n", path);
+        GB_save_destroy(save);
+        return NULL;
+    }
+
+    return save;
+}
+
+void GB_save_destroy(GB_save_t *save) {
+    if (!save) return;
+
+    if (save->data != MAP_FAILED) {
+        GB_save_flush(save, 1);
+        munmap(save->data, save->size);
+    }
+
+    if (save->fd >= 0) {
+        fsync(save->fd);
+        close(save->fd);
+    }
+
+    if (save->dirty) free(save->dirty);
+
+    free(save);
+}
+
+int GB_save_flush(GB_save_t *save, int wait) {
+    size_t page_count   = PAGE_COUNT(save);
+    int rv              = 0;
+
+    for (size_t page = 0; page < page_count; page++) {
+        if (!IS_DIRTY(save, page)) continue;
+
+        // Syncs the whole run of dirty pages at once
+        size_t end = page + 1;
+        while (end < page_count && IS_DIRTY(save, end)) end++;
+
+        size_t offset = page << save->page_shift;
+        size_t length = (end << save->page_shift) - offset;
+        if (offset + length > save->size) length = save->size - offset;
+
+        if (msync(save->data + offset, length, wait ? MS_SYNC : MS_ASYNC)) {
+            fprintf(stderr, "CANNOT SYNC SAVE FILE\n");
+            rv = -1;
+        }
+
+        page = end;
+    }
+
+    memset(save->dirty, 0, (page_count + 7) / 8);
+
+    return rv;
+}
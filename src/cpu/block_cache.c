@@ -0,0 +1,293 @@
+#include "cpu/block_cache.h"
+#include "cartridge/mbc.h"
+#include "memmap.h"
+#include "gb.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOCK_CACHE_SIZE        (2048)                                      // Must be a power of 2
+#define BLOCK_INDEX(key)        ( ( (key) ^ ((key) >> 11) ^ ((key) >> 13) ) & (BLOCK_CACHE_SIZE - 1) )
+#define BLOCK_KEY(bank, pc)     ( ( (DWORD)(bank) << 16 ) | (pc) )
+#define BLOCK_START(block)      ( (WORD)( (block)->key & 0xFFFF ) )
+
+/// One bit per WRAM and HRAM byte owned by a cached block
+#define CODE_MAP_HRAM_OFFSET    (GB_WRAM_END_ADDR - GB_WRAM_START_ADDR + 1)
+#define CODE_MAP_BITS           (CODE_MAP_HRAM_OFFSET + GB_HRAM_END_ADDR - GB_HRAM_START_ADDR + 1)
+#define CODE_MAP_TEST(i)        ( cache->code_map[(i) >> 3] &  (1 << ((i) & 7)) )
+#define CODE_MAP_SET(i)         ( cache->code_map[(i) >> 3] |= (1 << ((i) & 7)) )
+
+#define IS_RAM_BLOCK(block)     ( BLOCK_START(block) >= GB_WRAM_START_ADDR )
+
+struct GB_block_cache_s {
+    GB_block_t          blocks[BLOCK_CACHE_SIZE];
+    BYTE                code_map[(CODE_MAP_BITS + 7) / 8];
+    int                 ram_block_count;
+};
+
+/// Instruction lengths as consumed by the handlers in instr.h (STOP does not skip its padding byte)
+static const BYTE INSTR_LENGTH[256] = {
+/*        0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F */
+/* 0 */   1, 3, 1, 1, 1, 1, 2, 1, 3, 1, 1, 1, 1, 1, 2, 1,
+/* 1 */   1, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,
+/* 2 */   2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,
+/* 3 */   2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,
+/* 4 */   1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+/* 5 */   1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+/* 6 */   1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+/* 7 */   1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+/* 8 */   1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+/* 9 */   1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+/* A */   1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+/* B */   1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+/* C */   1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 2, 3, 3, 2, 1,
+/* D */   1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 3, 2, 1,
+/* E */   2, 1, 1, 1, 3, 1, 2, 1, 2, 1, 3, 1, 3, 3, 2, 1,
+/* F */   2, 1, 1, 1, 3, 1, 2, 1, 2, 1, 3, 1, 3, 3, 2, 1,
+};
+
+/// M-cycles with branches not taken, $CB is accounted with its second byte
+static const BYTE INSTR_CYCLES[256] = {
+/*        0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F */
+/* 0 */   1, 3, 2, 2, 1, 1, 2, 1, 5, 2, 2, 2, 1, 1, 2, 1,
+/* 1 */   1, 3, 2, 2, 1, 1, 2, 1, 3, 2, 2, 2, 1, 1, 2, 1,
+/* 2 */   2, 3, 2, 2, 1, 1, 2, 1, 2, 2, 2, 2, 1, 1, 2, 1,
+/* 3 */   2, 3, 2, 2, 3, 3, 3, 1, 2, 2, 2, 2, 1, 1, 2, 1,
+/* 4 */   1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,
+/* 5 */   1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,
+/* 6 */   1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,
+/* 7 */   2, 2, 2, 2, 2, 2, 1, 2, 1, 1, 1, 1, 1, 1, 2, 1,
+/* 8 */   1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,
+/* 9 */   1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,
+/* A */   1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,
+/* B */   1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,
+/* C */   2, 3, 3, 4, 3, 4, 2, 4, 2, 4, 3, 0, 3, 6, 2, 4,
+/* D */   2, 3, 3, 1, 3, 4, 2, 4, 2, 4, 3, 1, 3, 6, 2, 4,
+/* E */   3, 3, 2, 1, 3, 4, 2, 4, 4, 1, 4, 1, 3, 6, 2, 4,
+/* F */   3, 3, 2, 1, 3, 4, 2, 4, 3, 2, 4, 1, 3, 6, 2, 4,
+};
+
+static int cb_cycles(BYTE cb_opcode) {
+    if ((cb_opcode & 7) != 6) return 2;         // Register operand
+    return ((cb_opcode >> 6) == 1) ? 3 : 4;     // BIT b,(HL) does not write back
+}
+
+/// Control flow, HALT and STOP terminate a block
+static int ends_block(BYTE opcode) {
+    switch (opcode) {
+        case 0x10: case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: case 0x76:
+        case 0xC0: case 0xC2: case 0xC3: case 0xC4: case 0xC8: case 0xC9: case 0xCA: case 0xCC: case 0xCD:
+        case 0xD0: case 0xD2: case 0xD4: case 0xD8: case 0xD9: case 0xDA: case 0xDC: case 0xDD:
+        case 0xE4: case 0xE9: case 0xEC: case 0xED:
+        case 0xF4: case 0xFC: case 0xFD:
+            return 1;
+    }
+
+    return (opcode & 0xC7) == 0xC7; // RST
+}
+
+/// Last address of the area holding pc that can be decoded ahead of time, 0 if none
+static WORD cacheable_area_end(WORD pc) {
+    if (pc < 0x4000)                                            return 0x3FFF;
+    if (pc <= GB_ROM_END_ADDR)                                  return GB_ROM_END_ADDR;
+    if (pc >= GB_WRAM_START_ADDR && pc <= GB_WRAM_END_ADDR)     return GB_WRAM_END_ADDR;
+    if (pc >= GB_HRAM_START_ADDR && pc <= GB_HRAM_END_ADDR)     return GB_HRAM_END_ADDR;
+    return 0;
+}
+
+/// Side-effect free read of cacheable memory
+static BYTE peek(GB_gameboy_t *gb, WORD addr) {
+    if (addr <= GB_ROM_END_ADDR)    return GB_mbc_read(gb->cartridge->mbc, addr);
+    if (addr <= GB_WRAM_END_ADDR)   return gb->state.wram[addr - GB_WRAM_START_ADDR];
+    return gb->state.hram[addr - GB_HRAM_START_ADDR];
+}
+
+static int code_map_index(WORD addr) {
+    if (addr >= GB_WRAM_START_ADDR && addr <= GB_WRAM_END_ADDR)             return addr - GB_WRAM_START_ADDR;
+    if (addr >= GB_ECHO_RAM_START_ADDR && addr <= GB_ECHO_RAM_END_ADDR)     return addr - GB_ECHO_RAM_START_ADDR;
+    if (addr >= GB_HRAM_START_ADDR && addr <= GB_HRAM_END_ADDR)             return CODE_MAP_HRAM_OFFSET + addr - GB_HRAM_START_ADDR;
+    return -1;
+}
+
+static void code_map_mark(GB_block_cache_t *cache, GB_block_t *block) {
+    for (WORD addr = BLOCK_START(block); addr != block->end; addr++) {
+        CODE_MAP_SET(code_map_index(addr));
+    }
+}
+
+/// IO registers that only change when a component runs
+static int is_polled_register(WORD addr) {
+    return addr == GB_JOYP_ADDR || addr == GB_IF_ADDR || addr == GB_STAT_ADDR || addr == GB_LY_ADDR;
+}
+
+/// Instructions only reading and writing A and F, whose repetition leaves them unchanged
+static int is_idempotent_alu(const GB_decoded_instr_t *instr) {
+    switch (instr->opcode) {
+        case 0xA7: /* AND A */ case 0xB7: /* OR A */ case 0xE6: /* AND n */ case 0xFE: /* CP n */
+            return 1;
+        case 0xCB:
+            return ( instr->operands[0] & 0xC7 ) == 0x47; // BIT b,A
+    }
+
+    return 0;
+}
+
+/**
+ * Recognizes a polling loop: an optional read of a polled register into A, then idempotent ALU instructions,
+ * then a branch back to the block start. Whatever value gets read, running two iterations in a row leaves the
+ * CPU as one does, so the loop only evolves when a component runs.
+ *
+ * Returns the cost of one iteration in M-cycles, 0 when the block is not such a loop
+*/
+static int idle_loop_cycles(const GB_block_t *block) {
+    const GB_decoded_instr_t *first  = &block->instrs[0];
+    const GB_decoded_instr_t *branch = &block->instrs[block->instr_count - 1];
+    WORD start  = BLOCK_START(block);
+    int  i      = 0;
+    int  taken  = 0;                                    // Extra M-cycle of a conditional branch taken
+    int  target;
+
+    if      (first->opcode == 0xF0) i += is_polled_register(0xFF00 | first->operands[0]);                               // LDH A,(n)
+    else if (first->opcode == 0xFA) i += is_polled_register(first->operands[0] | (first->operands[1] << 8));         // LD A,(nn)
+
+    for (; i < block->instr_count - 1; i++) {
+        if (!is_idempotent_alu(&block->instrs[i])) return 0;
+    }
+
+    switch (branch->opcode) {
+        case 0x20: case 0x28: case 0x30: case 0x38:                 // JR cc,e
+            taken = 1;
+            /* fall through */
+        case 0x18:                                                  // JR e
+            target = branch->pc + 2 + (signed char)branch->operands[0];
+            break;
+        case 0xC2: case 0xCA: case 0xD2: case 0xDA:                 // JP cc,nn
+            taken = 1;
+            /* fall through */
+        case 0xC3:                                                  // JP nn
+            target = branch->operands[0] | (branch->operands[1] << 8);
+            break;
+        default:
+            return 0;
+    }
+
+    if (target != start) return 0;
+
+    return block->cycles + taken; // INSTR_CYCLES holds the cost of a conditional branch not taken
+}
+
+static void decode_block(GB_gameboy_t *gb, GB_block_t *block, DWORD key) {
+    WORD pc     = key & 0xFFFF;
+    WORD last   = cacheable_area_end(pc);
+
+    block->key              = key;
+    block->is_valid         = 1;
+    block->instr_count      = 0;
+    block->cycles           = 0;
+
+    while (block->instr_count < GB_BLOCK_MAX_INSTRS) {
+        BYTE opcode = peek(gb, pc);
+        int  length = INSTR_LENGTH[opcode];
+
+        if (pc + length - 1 > last) {
+            break; // Straddles a bank or area boundary, left to the bus
+        }
+
+        GB_decoded_instr_t *instr = &block->instrs[block->instr_count++];
+        instr->pc       = pc;
+        instr->opcode   = opcode;
+        instr->length   = length;
+        for (int i = 1; i < length; i++) {
+            instr->operands[i - 1] = peek(gb, pc + i);
+        }
+        instr->cycles   = (opcode == 0xCB) ? cb_cycles(instr->operands[0]) : INSTR_CYCLES[opcode];
+
+        block->cycles  += instr->cycles;
+        pc             += length;
+
+        if (ends_block(opcode)) break;
+    }
+
+    block->end              = pc;
+    block->idle_loop_cycles = block->instr_count ? idle_loop_cycles(block) : 0;
+}
+
+GB_block_cache_t* GB_block_cache_create() {
+    GB_block_cache_t *cache = (GB_block_cache_t*)( malloc( sizeof (GB_block_cache_t) ) );
+
+    if (cache != NULL) {
+        memset(cache, 0, sizeof (GB_block_cache_t));
+    }
+
+    return cache;
+}
+
+void GB_block_cache_destroy(GB_block_cache_t *cache) {
+    if (cache) free(cache);
+}
+
+GB_block_t* GB_block_cache_lookup(GB_gameboy_t *gb, WORD pc) {
+    GB_block_cache_t *cache = gb->exec->block_cache;
+
+    if (!cacheable_area_end(pc)) {
+        return NULL;
+    }
+
+    int bank            = (pc <= GB_ROM_END_ADDR) ? GB_mbc_rom_bank(gb->cartridge->mbc, pc) : 0;
+    DWORD key           = BLOCK_KEY(bank, pc);
+    GB_block_t *block   = &cache->blocks[BLOCK_INDEX(key)];
+
+    if (block->is_valid && block->key == key) {
+        return block;
+    }
+
+    if (block->is_valid && IS_RAM_BLOCK(block)) {
+        cache->ram_block_count--;
+    }
+
+    decode_block(gb, block, key);
+    if (!block->instr_count) {
+        block->is_valid = 0;
+        return NULL;
+    }
+
+    if (IS_RAM_BLOCK(block)) {
+        cache->ram_block_count++;
+        code_map_mark(cache, block);
+    }
+
+    return block;
+}
+
+void GB_block_cache_write_notify(GB_gameboy_t *gb, WORD addr) {
+    GB_block_cache_t *cache = gb->exec->block_cache;
+
+    if (addr <= GB_ROM_END_ADDR) {
+        gb->exec->block = NULL; // MBC register, the mapping under PC may change
+        return;
+    }
+
+    if (!cache->ram_block_count) return;
+
+    int index = code_map_index(addr);
+    if (index < 0 || !CODE_MAP_TEST(index)) return;
+
+    // Self-modifying code: drop every block holding the byte then rebuild the map from the survivors
+    WORD wram_addr = (addr >= GB_ECHO_RAM_START_ADDR && addr <= GB_ECHO_RAM_END_ADDR) ? addr - 0x2000 : addr;
+
+    memset(cache->code_map, 0, sizeof (cache->code_map));
+    for (int i = 0; i < BLOCK_CACHE_SIZE; i++) {
+        GB_block_t *block = &cache->blocks[i];
+
+        if (!block->is_valid || !IS_RAM_BLOCK(block)) continue;
+
+        if (wram_addr >= BLOCK_START(block) && wram_addr < block->end) {
+            block->is_valid = 0;
+            cache->ram_block_count--;
+        } else {
+            code_map_mark(cache, block);
+        }
+    }
+
+    gb->exec->block = NULL;
+}
@@ -1,51 +1,139 @@
 #include "cpu/cpu.h"
 #include "cpu/timer.h"
 #include "cpu/decode.h"
+#include "debugger.h"
 #include "gb_utils.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 
-GB_cpu_t* GB_cpu_create() {
-    GB_cpu_t *cpu               = (GB_cpu_t*)( malloc( sizeof(GB_cpu_t) ) );
+void GB_cpu_init(GB_cpu_t *cpu) {
     cpu->ir                     = 0;
     cpu->prev_ir                = 0;
-    cpu->af.w                   = 0;
-    cpu->bc.w                   = 0;
-    cpu->de.w                   = 0;
-    cpu->hl.w                   = 0;
-    cpu->sp.w                   = 0;
-    cpu->pc.w                   = 0;
-    cpu->wz.w                   = 0;
+    cpu->regs.af.w              = 0;
+    cpu->regs.bc.w              = 0;
+    cpu->regs.de.w              = 0;
+    cpu->regs.hl.w              = 0;
+    cpu->regs.sp.w              = 0;
+    cpu->regs.pc.w              = 0;
+    cpu->regs.wz.w              = 0;
+    cpu->flags_op               = 0;
+    cpu->flags_lhs              = 0;
+    cpu->flags_rhs              = 0;
+    cpu->flags_carry            = 0;
+    cpu->flags_res              = 0;
     cpu->IME                    = 0;
     cpu->ei_delay               = 0;
     cpu->is_halted              = 0;
     cpu->is_stopped             = 0;
     cpu->t_cycle_counter        = 0;
-    cpu->timer                  = GB_timer_create();
+    GB_timer_init(&cpu->timer);
+}
+
+GB_exec_t* GB_exec_create() {
+    GB_exec_t *exec             = (GB_exec_t*)( malloc( sizeof(GB_exec_t) ) );
+
+    if (!exec) {
+        return NULL;
+    }
+
+    exec->block_cache           = GB_block_cache_create();
+    exec->block                 = NULL;
+    exec->block_pos             = 0;
+    exec->instr                 = NULL;
+    exec->idle_block            = NULL;
+    exec->idle_t                = 0;
+    exec->idle_next             = 0;
+#ifdef GB_PROFILER
+    exec->profiler              = NULL;
+#endif
+
+    if (!exec->block_cache) {
+        GB_exec_destroy(exec);
+        return NULL;
+    }
 
-    return cpu;                                                                         
+    return exec;                                                                         
 }
 
-void GB_cpu_destroy(GB_cpu_t *cpu) {
-    if (cpu == NULL) return; 
-    GB_timer_destroy(cpu->timer);
+void GB_exec_destroy(GB_exec_t *exec) {
+    if (exec == NULL) return; 
+#ifdef GB_PROFILER
+    GB_profiler_destroy(exec->profiler);
+#endif
+    GB_block_cache_destroy(exec->block_cache);
 
-    free(cpu);
+    free(exec);
+}
+
+static void decode_cb(GB_gameboy_t *gb) {
+    DECODE_CB();
+}
+
+DECL_OPCODE_HANDLERS()
+
+/**
+ * Called at the start of an instruction. Once a whole iteration of an idle loop went by without any component
+ * running, the following ones would read the same values and take the same branch: skips as many of them as
+ * fit before the earliest deadline, the next iteration then runs normally and sees the component update.
+*/
+void GB_cpu_skip_idle_loop(GB_gameboy_t *gb) {
+    GB_cpu_t   *cpu     = &gb->state.cpu;
+    GB_exec_t  *exec    = gb->exec;
+    GB_block_t *block   = exec->block;
+
+    if (!block || !block->idle_loop_cycles || exec->instr != &block->instrs[0]) return;
+
+    uint64_t t      = cpu->t_cycle_counter;
+    uint64_t next   = GB_scheduler_next(&gb->state.scheduler);
+    uint64_t cycles = 4 * (uint64_t)block->idle_loop_cycles;
+
+    // Exactly one iteration since last entry, leaving the loop and coming back or serving an interrupt takes longer.
+    // No deadline reached in between either
+    if (exec->idle_block == block && t - exec->idle_t == cycles && t < exec->idle_next &&
+        !cpu->ei_delay && !( _IME && PENDING_INTERRUPTS() ) && t < next && next != GB_EVENT_NEVER) {
+        t += ( ( next - 1 - t ) / cycles ) * cycles;
+        cpu->t_cycle_counter = t;
+    }
+
+    exec->idle_block = block;
+    exec->idle_t     = t;
+    exec->idle_next  = next;
+}
+
+/**
+ * While halted without any pending interrupt, only a component can wake the CPU up: jumps to the cycle before the earliest deadline.
+ * The skipped cycles would not have run any component, the ones that sleep catch up on their own
+*/
+static void halt_fast_forward(GB_gameboy_t *gb) {
+    uint64_t next = GB_scheduler_next(&gb->state.scheduler);
+
+    if (next != GB_EVENT_NEVER && next > gb->state.cpu.t_cycle_counter + 4 && !PENDING_INTERRUPTS()) {
+        gb->state.cpu.t_cycle_counter = next - 4;
+    }
 }
 
 void GB_cpu_run(GB_gameboy_t *gb) {
-    if (!gb->cpu->is_halted) {
+    if (gb->debugger && GB_debugger_check(gb)) return;
+
+    if (!gb->state.cpu.is_halted) {
+        // Idle loops run in full while debugging so each instruction gets checked
+        if (!gb->debugger) GB_cpu_skip_idle_loop(gb);
+
+        PROFILE_INSTR_BEGIN();
         DECODE();
+        PROFILE_INSTR_END();
         FETCH_CYCLE();
     } else {
+        PROFILE_HALT_BEGIN();
+        halt_fast_forward(gb);
         INC_CYCLE();
+        PROFILE_HALT_END();
         GB_interrupt_handle(gb, IR, PREV_IR);
     }
 
-    if (gb->cpu->ei_delay) {
-        gb->cpu->ei_delay = 0;
-        _IME = 1;
-    }
+    EI_DELAY_UPDATE();
+
+    if (GB_DEBUGGER_STOPPED(gb)) gb->debugger->hit.cpu = gb->state.cpu; // Watchpoint hit
 }
 
@@ -0,0 +1,80 @@
+/**
+ * Batched interpreter: runs instructions on a local copy of the registers that the compiler can keep in host
+ * registers, instead of going through gb->state.cpu at every access and reloading after every component call.
+ * The copy is written back to gb->state.cpu.regs around the code working on it: interrupt service, halted
+ * execution (GB_cpu_run) and the end of the batch.
+*/
+#define GB_REGS                 (*regs)
+#define OPCODE_HANDLER_PARAMS   GB_gameboy_t *gb, GB_cpu_regs_t *regs
+#define OPCODE_HANDLER_ARGS     gb, regs
+#define OPCODE_HANDLER_UNUSED() ( (void)gb, (void)regs )
+#define GB_REGS_STORE()         ( gb->state.cpu.regs = *regs )
+#define GB_REGS_LOAD()          ( *regs = gb->state.cpu.regs )
+
+#include "cpu/cpu.h"
+#include "cpu/decode.h"
+#include "debugger.h"
+#include "gb_utils.h"
+
+static void decode_cb(OPCODE_HANDLER_PARAMS) {
+    OPCODE_HANDLER_UNUSED();
+    DECODE_CB();
+}
+
+DECL_OPCODE_HANDLERS()
+
+#define _FUSED_FIRST(first, second)     || FIRST == (first)
+#define _FUSED_SECOND(first, second)    || ( FIRST == (first) && IR == (second) )
+#define _FUSED_RUN(first, second)       else if ( FIRST == (first) && IR == (second) ) op_##second(OPCODE_HANDLER_ARGS);
+
+/**
+ * Dispatch of the batch loop. The first instruction of a pair in FUSED_PAIRS fetches the next one itself and runs it
+ * right away when it is a second of the pair, skipping the loop checks in between (the idle loop skip only misses
+ * a chance). Anything else, HALT mode included, goes back to the loop.
+ * FIRST is constant in each case so all but the matching pairs fold away
+*/
+#define _BATCH_CASE(opcode, instr)                                                          \
+    case opcode: {                                                                          \
+        enum { FIRST = opcode };                                                            \
+        op_##opcode(OPCODE_HANDLER_ARGS);                                                   \
+        if ( ( 0 FUSED_PAIRS(_FUSED_FIRST) ) && count ) {                                   \
+            PROFILE_INSTR_END();                                                            \
+            FETCH_CYCLE();                                                                  \
+            EI_DELAY_UPDATE();                                                              \
+            if ( gb->state.cpu.is_halted || !( 0 FUSED_PAIRS(_FUSED_SECOND) ) ) continue;   \
+            count--;                                                                        \
+            PROFILE_INSTR_BEGIN();                                                          \
+            if (0) {} FUSED_PAIRS(_FUSED_RUN)                                               \
+        }                                                                                   \
+    } break;
+
+void GB_cpu_run_batch(GB_gameboy_t *gb, int count) {
+    if (gb->debugger) {
+        while (count-- && !GB_DEBUGGER_STOPPED(gb)) GB_cpu_run(gb);
+        return;
+    }
+
+    GB_cpu_regs_t   local       = gb->state.cpu.regs;
+    GB_cpu_regs_t  *regs        = &local;
+
+    while (count--) {
+        if (gb->state.cpu.is_halted) {
+            GB_REGS_STORE();
+            GB_cpu_run(gb);
+            GB_REGS_LOAD();
+            continue;
+        }
+
+        GB_cpu_skip_idle_loop(gb);
+
+        PROFILE_INSTR_BEGIN();
+        switch (IR) {
+            OPCODE_TABLE(_BATCH_CASE)
+        }
+        PROFILE_INSTR_END();
+        FETCH_CYCLE();
+        EI_DELAY_UPDATE();
+    }
+
+    GB_REGS_STORE();
+}
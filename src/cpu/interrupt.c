@@ -5,8 +5,8 @@
 #include "cpudef.h"
 #include "mmu.h"
 
-#define IE ( gb->ie )
-#define IF ( gb->io_regs[GB_IF_ADDR & 0xFF] )
+#define IE ( gb->state.ie )
+#define IF ( gb->state.io_regs[GB_IF_ADDR & 0xFF] )
 
 #define IRQ ( IE & IF & 0x1F )
 
@@ -21,14 +21,14 @@ static const int INTERRUPT_VECTOR[] = {
 #define SERVE_INTERRUPT() do {                                                                                                  \
     WORD pc = PC-1;                 INC_CYCLE();    /* M0: Adjust PC as handling happens after fetch and fetch does PC++  */    \
     SP--;                           INC_CYCLE();    /* M1 */                                                                    \
-    GB_mem_write(gb, SP--, (pc>>8));INC_CYCLE();    /* M2 */                                                                    \
-    GB_mem_write(gb, SP, (pc&0xFF));INC_CYCLE();    /* M3 */                                                                    \
+    GB_cpu_write(gb, SP--, (pc>>8));INC_CYCLE();    /* M2 */                                                                    \
+    GB_cpu_write(gb, SP, (pc&0xFF));INC_CYCLE();    /* M3 */                                                                    \
     int irq = IRQ, irq_index = 0;                                                                                               \
     while( !(irq & 1) ) { irq >>= 1; irq_index++; } /* M3 */                                                                    \
     PC = (8 * irq_index) + 0x40;                    /* M3 */                                                                    \
     IF &= ~(1 << irq_index);                        /* M3 */                                                                    \
     _IME = 0;                                       /* M4 */                                                                    \
-    IR = GB_mem_read(gb, PC++);     INC_CYCLE();    /* M4 */                                                                    \
+    IR = GB_fetch_opcode(gb, PC++); INC_CYCLE();    /* M4 */                                                                    \
 } while(0)
 
 
@@ -37,6 +37,7 @@ static const int INTERRUPT_VECTOR[] = {
         SERVE_INTERRUPT();                                                                                                      \
     } else { /* Either adjust RST's pushed address or else read byte twice */                                                   \
         PC--;                                                                                                                   \
+        gb->exec->instr = NULL; /* Immediates are read from the bus, starting at the opcode again */                            \
     }                                                                                                                           \
 } while(0)
 
@@ -49,5 +50,5 @@ void GB_interrupt_handle(GB_gameboy_t *gb, BYTE ir, BYTE prev_ir) {
         SERVE_INTERRUPT();
     }
 
-    gb->cpu->is_halted  = 0;
+    gb->state.cpu.is_halted  = 0;
 }
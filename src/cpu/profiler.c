@@ -0,0 +1,134 @@
+#include "cpu/profiler.h"
+#include "cpu/decode.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define _OPCODE_NAME(opcode, instr) #instr,
+
+static const char *const OPCODE_NAMES[256]  = { OPCODE_TABLE(_OPCODE_NAME) };
+static const char *const CB_ROT_NAMES[8]    = { "RLC", "RRC", "RL", "RR", "SLA", "SRA", "SWAP", "SRL" };
+static const char *const CB_OP_NAMES[4]     = { NULL, "BIT", "RES", "SET" };
+
+static const char* slot_name(int slot) {
+    if (slot < GB_PROFILER_CB_OFFSET) return OPCODE_NAMES[slot];
+
+    BYTE cb = slot & 0xFF;
+    return (cb >> 6) ? CB_OP_NAMES[cb >> 6] : CB_ROT_NAMES[(cb >> 3) & 7];
+}
+
+/// $CB opcodes are written as their two bytes
+static void slot_opcode(int slot, char *buf, size_t size) {
+    snprintf(buf, size, slot < GB_PROFILER_CB_OFFSET ? "0x%02X" : "0xCB%02X", slot & 0xFF);
+}
+
+GB_profiler_t* GB_profiler_create() {
+    GB_profiler_t *profiler = (GB_profiler_t*)( malloc( sizeof (GB_profiler_t) ) );
+
+    if (profiler != NULL) {
+        memset(profiler, 0, sizeof (GB_profiler_t));
+        profiler->prev_op = -1;
+    }
+
+    return profiler;
+}
+
+void GB_profiler_destroy(GB_profiler_t *profiler) {
+    if (profiler) free(profiler);
+}
+
+/// Fills pairs with the first then second opcode of the most frequent pairs, by decreasing count. Returns how many
+static int top_pairs(const GB_profiler_t *profiler, int pairs[GB_PROFILER_TOP_PAIRS][2]) {
+    int n = 0;
+
+    for (int first = 0; first < 256; first++) {
+        for (int second = 0; second < 256; second++) {
+            uint64_t count = profiler->pair_count[first][second];
+
+            if (!count) continue;
+
+            // Insertion from the end, dropping the last one once full
+            int i = n < GB_PROFILER_TOP_PAIRS ? n++ : GB_PROFILER_TOP_PAIRS;
+            for (; i > 0 && profiler->pair_count[ pairs[i - 1][0] ][ pairs[i - 1][1] ] < count; i--) {
+                if (i < GB_PROFILER_TOP_PAIRS) {
+                    pairs[i][0] = pairs[i - 1][0];
+                    pairs[i][1] = pairs[i - 1][1];
+                }
+            }
+            if (i < GB_PROFILER_TOP_PAIRS) {
+                pairs[i][0] = first;
+                pairs[i][1] = second;
+            }
+        }
+    }
+
+    return n;
+}
+
+static void export_csv(const GB_profiler_t *profiler, FILE *f) {
+    char opcode[8];
+
+    fprintf(f, "opcode,instr,count,t_cycles\n");
+    for (int i = 0; i < GB_PROFILER_SLOTS; i++) {
+        if (!profiler->count[i]) continue;
+        slot_opcode(i, opcode, sizeof opcode);
+        fprintf(f, "%s,%s,%llu,%llu\n", opcode, slot_name(i),
+                (unsigned long long)profiler->count[i], (unsigned long long)profiler->t_cycles[i]);
+    }
+    fprintf(f, "HALTED,,,%llu\n", (unsigned long long)profiler->halted_t_cycles);
+
+    int pairs[GB_PROFILER_TOP_PAIRS][2];
+    int n = top_pairs(profiler, pairs);
+
+    for (int i = 0; i < n; i++) {
+        fprintf(f, "0x%02X+0x%02X,%s+%s,%llu,\n", pairs[i][0], pairs[i][1], OPCODE_NAMES[ pairs[i][0] ], OPCODE_NAMES[ pairs[i][1] ],
+                (unsigned long long)profiler->pair_count[ pairs[i][0] ][ pairs[i][1] ]);
+    }
+}
+
+static void export_json(const GB_profiler_t *profiler, FILE *f) {
+    char opcode[8];
+    const char *sep = "";
+
+    fprintf(f, "{\n  \"opcodes\": [");
+    for (int i = 0; i < GB_PROFILER_SLOTS; i++) {
+        if (!profiler->count[i]) continue;
+        slot_opcode(i, opcode, sizeof opcode);
+        fprintf(f, "%s\n    { \"opcode\": \"%s\", \"instr\": \"%s\", \"count\": %llu, \"t_cycles\": %llu }", sep, opcode, slot_name(i),
+                (unsigned long long)profiler->count[i], (unsigned long long)profiler->t_cycles[i]);
+        sep = ",";
+    }
+    fprintf(f, "\n  ],\n  \"halted_t_cycles\": %llu,\n  \"pairs\": [", (unsigned long long)profiler->halted_t_cycles);
+
+    int pairs[GB_PROFILER_TOP_PAIRS][2];
+    int n = top_pairs(profiler, pairs);
+
+    sep = "";
+    for (int i = 0; i < n; i++) {
+        fprintf(f, "%s\n    { \"first\": \"0x%02X\", \"second\": \"0x%02X\", \"instr\": \"%s+%s\", \"count\": %llu }", sep,
+                pairs[i][0], pairs[i][1], OPCODE_NAMES[ pairs[i][0] ], OPCODE_NAMES[ pairs[i][1] ],
+                (unsigned long long)profiler->pair_count[ pairs[i][0] ][ pairs[i][1] ]);
+        sep = ",";
+    }
+    fprintf(f, "\n  ]\n}\n");
+}
+
+int GB_profiler_export(const GB_profiler_t *profiler, const char *path) {
+    size_t  len = strlen(path);
+    FILE   *f   = fopen(path, "w");
+
+    if (!f) {
+        fprintf(stderr, "CANNOT WRITE PROFILE TO %s\n", path);
+        return -1;
+    }
+
+    if (len >= 5 && !strcmp(path + len - 5, ".json")) {
+        export_json(profiler, f);
+    } else {
+        export_csv(profiler, f);
+    }
+
+    fclose(f);
+    return 0;
+}
@@ -1,23 +1,28 @@
 #include "cpu/timer.h"
 #include "cpu/interrupt.h"
 #include "gb.h"
+#include "scheduler.h"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 
-#define TIMER                   ( gb->cpu->timer            )
+#define TIMER                   ( &gb->state.cpu.timer     )
 #define SYSCLK                  ( TIMER->sysclk             )
 #define LAST_TIMA_INC_VAL       ( TIMER->last_tima_inc_val  )
 #define TIMA_STATE              ( TIMER->tima_state         )
 
-#define DIV                     ( gb->io_regs[4] )
-#define TIMA                    ( gb->io_regs[5] )
-#define TMA                     ( gb->io_regs[6] )
-#define TAC                     ( gb->io_regs[7] )
+#define DIV                     ( gb->state.io_regs[4] )
+#define TIMA                    ( gb->state.io_regs[5] )
+#define TMA                     ( gb->state.io_regs[6] )
+#define TAC                     ( gb->state.io_regs[7] )
 
 #define TAC_SEL                 ( TAC &  3 )
 #define TAC_ENABLE              ( TAC >> 2 )
 
+#define TIMA_INC_VAL            ( TAC_ENABLE && ( TAC_MULTIPLEXER[TAC_SEL] & SYSCLK ) )
+#define TIMA_PERIOD             ( TAC_MULTIPLEXER[TAC_SEL] * 2 )   /* SYSCLK increments between two falling edges */
+
 
 #define TIMA_OVERFLOWED         (1)
 #define TIMA_RELOADING          (2)
@@ -26,29 +31,15 @@
 
 static const int TAC_MULTIPLEXER[] = { 512, 8, 32, 128 };
 
-struct GB_timer_s {
-    WORD sysclk;
-    int last_tima_inc_val;
-    int tima_state;
-};
-
-GB_timer_t* GB_timer_create() {
-    GB_timer_t *timer = (GB_timer_t*)( malloc( sizeof (GB_timer_t) ) );
-    
-    if (timer != NULL) {
-        timer->sysclk = 0;
-        timer->last_tima_inc_val = 0;
-        timer->tima_state = TIMA_INC;
-    }
-
-    return timer;
+void GB_timer_init(GB_timer_t *timer) {
+    timer->sysclk = 0;
+    timer->last_tima_inc_val = 0;
+    timer->tima_state = TIMA_INC;
+    timer->last_sync = 0;
 }
 
-void GB_timer_destroy(GB_timer_t *timer) {
-    if (timer) free(timer);
-}
-
-void GB_timer_update(GB_gameboy_t *gb) {
+/// Advances the timer by one M-cycle
+static void timer_tick(GB_gameboy_t *gb) {
     int tima_inc_val;
 
     if (TIMA_STATE < TIMA_INC) {
@@ -57,7 +48,7 @@ void GB_timer_update(GB_gameboy_t *gb) {
 
     for (int i = 0; i < 4; i++) {
         SYSCLK++;
-        tima_inc_val = TAC_ENABLE && ( TAC_MULTIPLEXER[TAC_SEL] & SYSCLK );
+        tima_inc_val = TIMA_INC_VAL;
 
         if ( (TIMA_STATE == TIMA_INC) && LAST_TIMA_INC_VAL && !tima_inc_val ) {
             if (TIMA == 0xFF) { TIMA_STATE = TIMA_OVERFLOWED; }
@@ -72,11 +63,67 @@ void GB_timer_update(GB_gameboy_t *gb) {
         TIMA_STATE = TIMA_RELOADED;
         REQUEST_INTERRUPT(IF_TIMER);
     }
+}
+
+/// M-cycles ahead during which TIMA can only count up, without overflowing nor seeing a DIV/TAC write glitch
+static uint64_t timer_quiet_cycles(GB_gameboy_t *gb) {
+    if (TIMA_STATE != TIMA_INC || LAST_TIMA_INC_VAL != TIMA_INC_VAL) return 0;
+    if (!TAC_ENABLE) return UINT64_MAX;
+
+    uint64_t first_edge     = TIMA_PERIOD - ( SYSCLK % TIMA_PERIOD );
+    uint64_t overflow_edge  = first_edge + (uint64_t)( 0xFF - TIMA ) * TIMA_PERIOD;
+
+    return ( overflow_edge - 1 ) / 4; // Cycles strictly before the one overflowing TIMA
+}
+
+/// Advances the timer by several quiet M-cycles at once
+static void timer_skip(GB_gameboy_t *gb, uint64_t cycles) {
+    uint64_t from   = SYSCLK;
+    uint64_t to     = from + 4 * cycles;
+
+    if (TAC_ENABLE) {
+        TIMA += ( to / TIMA_PERIOD ) - ( from / TIMA_PERIOD );
+    }
+
+    SYSCLK = (WORD)to;
+    LAST_TIMA_INC_VAL = TIMA_INC_VAL;
+}
+
+void GB_timer_sync(GB_gameboy_t *gb) {
+    uint64_t cycles = ( gb->state.cpu.t_cycle_counter - TIMER->last_sync ) / 4;
+    TIMER->last_sync = gb->state.cpu.t_cycle_counter;
+
+    while (cycles) {
+        uint64_t quiet = timer_quiet_cycles(gb);
+
+        if (quiet) {
+            if (quiet > cycles) quiet = cycles;
+            timer_skip(gb, quiet);
+            cycles -= quiet;
+        } else {
+            timer_tick(gb);
+            cycles--;
+        }
+    }
 
     DIV = SYSCLK>>8;
 }
 
+void GB_timer_update(GB_gameboy_t *gb) {
+    GB_timer_sync(gb);
+
+    uint64_t quiet = timer_quiet_cycles(gb);
+    if (quiet == UINT64_MAX) {
+        GB_UNSCHEDULE(gb, GB_EVENT_TIMER);
+    } else {
+        GB_SCHEDULE_IN(gb, GB_EVENT_TIMER, quiet + 1);
+    }
+}
+
 BYTE GB_timer_write_check(GB_gameboy_t *gb, WORD addr, BYTE data) {
+    GB_timer_sync(gb);
+    GB_SCHEDULE_ASAP(gb, GB_EVENT_TIMER);
+
     /* Checks if TIMA is written during the M-cycle delay */
     if (addr == 0xFF05) {
         if (TIMA_STATE != TIMA_RELOADED) {
@@ -0,0 +1,164 @@
+#include "debugger.h"
+#include "cartridge/mbc.h"
+#include "cpu/instr.h"
+#include "memmap.h"
+#include "gb.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BIT_TEST(map, i)        ( (map)[(i) >> 3] & ( 1 << ((i) & 7) ) )
+#define BIT_SET(map, i)         ( (map)[(i) >> 3] |= (BYTE)( 1 << ((i) & 7) ) )
+#define BIT_CLEAR(map, i)       ( (map)[(i) >> 3] &= (BYTE)~( 1 << ((i) & 7) ) )
+
+#define ROM_OFFSET(addr)        ( (addr) & (GB_DEBUGGER_BANK_SIZE - 1) )
+
+GB_debugger_t* GB_debugger_create() {
+    GB_debugger_t *debugger = (GB_debugger_t*)( malloc( sizeof (GB_debugger_t) ) );
+
+    if (debugger != NULL) {
+        memset(debugger, 0, sizeof (GB_debugger_t));
+        debugger->hit.reason = GB_DEBUGGER_RUNNING;
+    }
+
+    return debugger;
+}
+
+void GB_debugger_destroy(GB_debugger_t *debugger) {
+    if (!debugger) return;
+
+    for (int i = 0; i < GB_DEBUGGER_ROM_BANKS; i++) {
+        if (debugger->rom_breakpoints[i]) free(debugger->rom_breakpoints[i]);
+    }
+
+    free(debugger);
+}
+
+int GB_debugger_set_breakpoint(GB_debugger_t *debugger, int bank, WORD addr, int enabled) {
+    BYTE *map = debugger->breakpoints;
+    WORD offset = addr - 0x8000;
+
+    if (addr <= GB_ROM_END_ADDR) {
+        if (bank < 0 || bank >= GB_DEBUGGER_ROM_BANKS) {
+            fprintf(stderr, "INVALID ROM BANK %d\n", bank);
+            return -1;
+        }
+
+        if (!debugger->rom_breakpoints[bank]) {
+            if (!enabled) return 0;
+            debugger->rom_breakpoints[bank] = (BYTE*)( calloc( GB_DEBUGGER_BANK_SIZE / 8, sizeof (BYTE) ) );
+            if (!debugger->rom_breakpoints[bank]) return -1;
+        }
+
+        map     = debugger->rom_breakpoints[bank];
+        offset  = ROM_OFFSET(addr);
+    }
+
+    if (enabled) {
+        BIT_SET(map, offset);
+    } else {
+        BIT_CLEAR(map, offset);
+    }
+
+    return 0;
+}
+
+void GB_debugger_set_watchpoint(GB_gameboy_t *gb, WORD addr, int access) {
+    GB_debugger_t *debugger = gb->debugger;
+    int page = addr >> 8;
+    int was_watched = debugger->watchpoints[addr] != 0;
+
+    debugger->watchpoints[addr] = (BYTE)( access & (GB_WATCH_READ | GB_WATCH_WRITE) );
+    debugger->page_watchpoints[page] += (debugger->watchpoints[addr] != 0) - was_watched;
+
+    GB_mmu_watch_page(gb, addr, debugger->page_watchpoints[page] != 0);
+}
+
+static int pc_bank(GB_gameboy_t *gb, WORD pc) {
+    return pc <= GB_ROM_END_ADDR ? GB_mbc_rom_bank(gb->cartridge->mbc, pc) : -1;
+}
+
+static int is_breakpoint(const GB_debugger_t *debugger, int bank, WORD pc) {
+    if (bank < 0) return BIT_TEST(debugger->breakpoints, pc - 0x8000) != 0;
+    if (bank >= GB_DEBUGGER_ROM_BANKS || !debugger->rom_breakpoints[bank]) return 0;
+    return BIT_TEST(debugger->rom_breakpoints[bank], ROM_OFFSET(pc)) != 0;
+}
+
+static void stop(GB_gameboy_t *gb, GB_debugger_stop_t reason, WORD addr, BYTE data) {
+    GB_debugger_t *debugger = gb->debugger;
+
+    debugger->hit.reason    = reason;
+    debugger->hit.pc        = debugger->pc;
+    debugger->hit.bank      = pc_bank(gb, debugger->pc);
+    debugger->hit.addr      = addr;
+    debugger->hit.data      = data;
+}
+
+/// The opcode got prefetched: the instruction about to run starts at PC - 1. Nothing runs while halted
+int GB_debugger_check(GB_gameboy_t *gb) {
+    GB_debugger_t *debugger = gb->debugger;
+
+    if (debugger->hit.reason != GB_DEBUGGER_RUNNING) return 1;
+    if (gb->state.cpu.is_halted) return 0;
+
+    debugger->pc = (WORD)( PC - 1 );
+
+    if (debugger->skip_breakpoint) {
+        debugger->skip_breakpoint = 0;
+        return 0;
+    }
+
+    if (is_breakpoint(debugger, pc_bank(gb, debugger->pc), debugger->pc)) {
+        stop(gb, GB_DEBUGGER_BREAKPOINT, debugger->pc, IR & 0xFF);
+        debugger->hit.cpu = gb->state.cpu;
+        return 1;
+    }
+
+    return 0;
+}
+
+void GB_debugger_watch_hit(GB_gameboy_t *gb, WORD addr, BYTE data, int access) {
+    GB_debugger_t *debugger = gb->debugger;
+
+    // First access wins until resumed
+    if (debugger->hit.reason != GB_DEBUGGER_RUNNING || !( debugger->watchpoints[addr] & access )) return;
+
+    stop(gb, access == GB_WATCH_READ ? GB_DEBUGGER_WATCH_READ : GB_DEBUGGER_WATCH_WRITE, addr, data);
+}
+
+void GB_debugger_resume(GB_debugger_t *debugger) {
+    debugger->skip_breakpoint = debugger->hit.reason == GB_DEBUGGER_BREAKPOINT;
+    debugger->hit.reason      = GB_DEBUGGER_RUNNING;
+}
+
+void GB_debugger_report(const GB_debugger_t *debugger, FILE *f) {
+    const GB_debugger_hit_t *hit = &debugger->hit;
+    GB_cpu_t cpu = hit->cpu;
+    BYTE flags = lazy_flags(&cpu, cpu.regs.af.b.l);
+
+    switch (hit->reason) {
+        case GB_DEBUGGER_BREAKPOINT:
+            fprintf(f, "BREAKPOINT");
+            break;
+        case GB_DEBUGGER_WATCH_READ:
+            fprintf(f, "READ $%02X FROM $%04X", hit->data, hit->addr);
+            break;
+        case GB_DEBUGGER_WATCH_WRITE:
+            fprintf(f, "WRITE $%02X TO $%04X", hit->data, hit->addr);
+            break;
+        default:
+            fprintf(f, "RUNNING\n");
+            return;
+    }
+
+    if (hit->bank >= 0) {
+        fprintf(f, " AT %02X:%04X\n", hit->bank, hit->pc);
+    } else {
+        fprintf(f, " AT $%04X\n", hit->pc);
+    }
+
+    fprintf(f, "AF=%02X%02X BC=%04X DE=%04X HL=%04X SP=%04X PC=%04X [%c%c%c%c] IME=%d%s CYCLE=%llu\n",
+            cpu.regs.af.b.h, flags, cpu.regs.bc.w, cpu.regs.de.w, cpu.regs.hl.w, cpu.regs.sp.w, hit->pc,
+            flags & ZF_TOGGLE ? 'Z' : '-', flags & NF_TOGGLE ? 'N' : '-', flags & HF_TOGGLE ? 'H' : '-', flags & CF_TOGGLE ? 'C' : '-',
+            cpu.IME, cpu.is_halted ? " HALTED" : "", (unsigned long long)cpu.t_cycle_counter);
+}
@@ -1,3 +1,5 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "gb.h"
 #include "cpudef.h"
 #include "joypad.h"
@@ -5,39 +7,44 @@
 #include "memmap.h"
 
 #include <stdlib.h>
-
-#define WRAM_SIZE       (0x2000)
-#define UNUSABLE_SIZE   (0x006F)
-#define IO_REGS_SIZE    (0x0080)
-#define HRAM_SIZE       (0x007F)
+#include <string.h>
 
 #define CHECK_ALLOC(var) if (!var) { GB_gameboy_destroy(gb); return NULL;}
-#define ALLOC_BYTE_ARRAY(elt_cnt) ( (BYTE*)( malloc( sizeof (BYTE) * elt_cnt + 1 ) ) )
 
 void gameboy_init(GB_gameboy_t *gb);
 
-GB_gameboy_t*   GB_gameboy_create(const char *rom_path, int headless) {
-    GB_gameboy_t *gb = (GB_gameboy_t*)( malloc( sizeof (GB_gameboy_t) ) );
-    CHECK_ALLOC(gb);
+GB_gameboy_t*   GB_gameboy_create(const char *rom_path, const char *save_path, int headless) {
+    GB_gameboy_t *gb = NULL;
+    if (posix_memalign((void**)&gb, GB_CACHE_LINE_SIZE, sizeof (GB_gameboy_t))) {
+        return NULL;
+    }
 
+    memset(&gb->state, 0, sizeof (GB_state_t));
     gb->cartridge   = NULL;
-    gb->cpu         = NULL;
-    gb->ppu         = NULL;
     gb->mmu         = NULL;
-    gb->wram        = NULL;
-    gb->unusable    = NULL;
-    gb->io_regs     = NULL;
-    gb->hram        = NULL;
-    gb->ie          = 0;
+    gb->exec        = NULL;
+    gb->joypad      = NULL;
+    gb->lcd         = NULL;
+    gb->debugger    = NULL;
+
+    gb->scanline_renderer = 0;
+    gb->frame_skip        = 0;
+    gb->save_flush_period = GB_SAVE_FLUSH_PERIOD;
+    gb->next_save_flush   = 0;
+
+    for (int i = 0; i < GB_EVENT_COUNT; i++) {
+        GB_SCHEDULE_ASAP(gb, i);
+    }
 
-    gb->cartridge = GB_cartridge_create(rom_path);
-    CHECK_ALLOC(gb->cartridge);
+    GB_cpu_init(&gb->state.cpu);
+    GB_ppu_init(&gb->state.ppu);
+    GB_dma_init(&gb->state.dma);
 
-    gb->cpu = GB_cpu_create();
-    CHECK_ALLOC(gb->cpu);
+    gb->cartridge = GB_cartridge_create(rom_path, save_path);
+    CHECK_ALLOC(gb->cartridge);
 
-    gb->ppu = GB_ppu_create(headless);
-    CHECK_ALLOC(gb->ppu);
+    gb->exec = GB_exec_create();
+    CHECK_ALLOC(gb->exec);
 
     gb->mmu = GB_mmu_create();
     CHECK_ALLOC(gb->mmu);
@@ -45,23 +52,17 @@ GB_gameboy_t*   GB_gameboy_create(const char *rom_path, int headless) {
     gb->joypad = GB_joypad_create();
     CHECK_ALLOC(gb->joypad);
 
-    gb->wram = ALLOC_BYTE_ARRAY(WRAM_SIZE);
-    CHECK_ALLOC(gb->wram); 
-
-    gb->unusable = ALLOC_BYTE_ARRAY(UNUSABLE_SIZE);
-    CHECK_ALLOC(gb->unusable);
-
-    gb->io_regs = ALLOC_BYTE_ARRAY(IO_REGS_SIZE);
-    CHECK_ALLOC(gb->io_regs);
-
-    gb->hram = ALLOC_BYTE_ARRAY(HRAM_SIZE);
-    CHECK_ALLOC(gb->hram);
+    if (!headless) {
+        gb->lcd = GB_lcd_create();
+        CHECK_ALLOC(gb->lcd);
+    }
 
+    GB_mmu_map(gb);
     gameboy_init(gb);
 
     // Temp fix
-    gb->io_regs[0x44] = 0x91;
-    gb->io_regs[0x40] = 0x91;
+    gb->state.io_regs[0x44] = 0x91;
+    gb->state.io_regs[0x40] = 0x91;
 
     return gb;
 }
@@ -69,19 +70,27 @@ GB_gameboy_t*   GB_gameboy_create(const char *rom_path, int headless) {
 void GB_gameboy_destroy(GB_gameboy_t *gb) {
     if (!gb) return;
 
-    if (gb->hram)       free(gb->hram);
-    if (gb->io_regs)    free(gb->io_regs);
-    if (gb->unusable)   free(gb->unusable);
-    if (gb->wram)       free(gb->wram);
+    if (gb->lcd)        GB_lcd_destroy(gb->lcd);
+    GB_debugger_destroy(gb->debugger);
     GB_joypad_destroy(gb->joypad);
     GB_mmu_destroy(gb->mmu);
-    GB_ppu_destroy(gb->ppu);
-    GB_cpu_destroy(gb->cpu);
+    GB_exec_destroy(gb->exec);
     GB_cartridge_destroy(gb->cartridge);
 
     free(gb);
 }
 
+void GB_gameboy_run(GB_gameboy_t *gb, int count) {
+    GB_cpu_run_batch(gb, count);
+
+    uint64_t t = gb->state.cpu.t_cycle_counter;
+
+    if (gb->save_flush_period > 0 && t >= gb->next_save_flush) {
+        GB_cartridge_flush(gb->cartridge);
+        gb->next_save_flush = t + (uint64_t)gb->save_flush_period * GB_T_CYCLES_PER_SECOND;
+    }
+}
+
 const static int DMG_INIT[] = {
 
     /* HWIO */
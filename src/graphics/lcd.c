@@ -2,6 +2,7 @@
 #include "win_utils.h"
 
 #include <SDL.h>
+#include <assert.h>
 
 #if !SDL_VERSION_ATLEAST(2,0,17)
 #error This backend requires SDL 2.0.17+ because of SDL_RenderGeometry() function
@@ -60,6 +61,20 @@ void GB_lcd_set_pixel(GB_LCD_t *lcd, int x, int y, int color_id) {
     lcd->context->pixels[index] = ( (color << 24)|(color << 16)|(color << 8)|0x000000FF );
 }
 
+/// Whole row of VIEWPORT_WIDTH pixels, y being a visible line
+void GB_lcd_set_line(GB_LCD_t *lcd, int y, const unsigned char *color_ids) {
+    if (lcd == NULL) return;
+
+    assert(y >= 0 && y < VIEWPORT_HEIGHT);
+
+    Uint32 *row = lcd->context->pixels + y * VIEWPORT_WIDTH;
+
+    for (int x = 0; x < VIEWPORT_WIDTH; x++) {
+        Uint32 color = gb_colors[color_ids[x]];
+        row[x] = ( (color << 24)|(color << 16)|(color << 8)|0x000000FF );
+    }
+}
+
 void GB_lcd_clear(GB_LCD_t *lcd) {
     if (lcd == NULL) return;
 
@@ -0,0 +1,95 @@
+#include "graphics/line.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#define GB_LINE_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef GB_LINE_SSE2
+
+#define BLEND(mask, a, b)               ( _mm_or_si128( _mm_and_si128(mask, a), _mm_andnot_si128(mask, b) ) )
+#define TEST(v, bits)                   ( _mm_cmpeq_epi8( _mm_and_si128(v, bits), bits ) )
+
+/// Pixel x sits at bits 15-2x and 14-2x: shifting left by 2x then right by 14 isolates it, in every lane at once
+static inline __m128i decode_row(WORD row) {
+    const __m128i shifts = _mm_setr_epi16(1, 1 << 2, 1 << 4, 1 << 6, 1 << 8, 1 << 10, 1 << 12, 1 << 14);
+
+    return _mm_srli_epi16( _mm_mullo_epi16( _mm_set1_epi16( (short)row ), shifts ), 14 );
+}
+
+void GB_line_decode(const WORD *rows, int count, BYTE *ids) {
+    int i = 0;
+
+    for (; i + 2 <= count; i += 2, ids += 16) {
+        _mm_storeu_si128( (__m128i*)ids, _mm_packus_epi16( decode_row(rows[i]), decode_row(rows[i + 1]) ) );
+    }
+
+    if (i < count) {
+        _mm_storel_epi64( (__m128i*)ids, _mm_packus_epi16( decode_row(rows[i]), _mm_setzero_si128() ) );
+    }
+}
+
+/// Shade of a color id through a palette of the same lane, the 4 entries being picked with 2 levels of masks
+static inline __m128i palette_map(__m128i pal, __m128i id) {
+    const __m128i three = _mm_set1_epi8(3);
+    const __m128i one   = _mm_set1_epi8(1);
+    const __m128i two   = _mm_set1_epi8(2);
+
+    // Shifting 16-bit lanes by at most 6 leaves the 2 low bits of each byte to the byte itself
+    __m128i c0  = _mm_and_si128( pal, three );
+    __m128i c1  = _mm_and_si128( _mm_srli_epi16(pal, 2), three );
+    __m128i c2  = _mm_and_si128( _mm_srli_epi16(pal, 4), three );
+    __m128i c3  = _mm_and_si128( _mm_srli_epi16(pal, 6), three );
+    __m128i odd = TEST(id, one);
+
+    return BLEND( TEST(id, two), BLEND(odd, c3, c2), BLEND(odd, c1, c0) );
+}
+
+void GB_line_compose(const BYTE *bg_ids, const BYTE *obj_ids, const BYTE *obj_attrs,
+                     BYTE bgp, BYTE obp0, BYTE obp1, BYTE *shades) {
+    const __m128i zero          = _mm_setzero_si128();
+    const __m128i bg_priority   = _mm_set1_epi8( (char)GB_OBJ_ATTR_BG_PRIORITY );
+    const __m128i palette       = _mm_set1_epi8( (char)GB_OBJ_ATTR_PALETTE );
+    const __m128i bg_pal        = _mm_set1_epi8( (char)bgp );
+    const __m128i obj_pal0      = _mm_set1_epi8( (char)obp0 );
+    const __m128i obj_pal1      = _mm_set1_epi8( (char)obp1 );
+
+    for (int x = 0; x < GB_LINE_WIDTH; x += 16) {
+        __m128i bg      = _mm_loadu_si128( (const __m128i*)(bg_ids + x) );
+        __m128i obj     = _mm_loadu_si128( (const __m128i*)(obj_ids + x) );
+        __m128i attrs   = _mm_loadu_si128( (const __m128i*)(obj_attrs + x) );
+
+        // Lanes keeping the background: transparent object, or behind an opaque background
+        __m128i hidden  = _mm_or_si128( _mm_cmpeq_epi8(obj, zero),
+                                        _mm_andnot_si128( _mm_cmpeq_epi8(bg, zero), TEST(attrs, bg_priority) ) );
+        __m128i id      = BLEND( hidden, bg, obj );
+        __m128i pal     = BLEND( hidden, bg_pal, BLEND( TEST(attrs, palette), obj_pal1, obj_pal0 ) );
+
+        _mm_storeu_si128( (__m128i*)(shades + x), palette_map(pal, id) );
+    }
+}
+
+#else
+
+void GB_line_decode(const WORD *rows, int count, BYTE *ids) {
+    for (int i = 0; i < count; i++, ids += 8) {
+        for (int x = 0; x < 8; x++) ids[x] = GB_TILE_ROW_PIXEL(rows[i], x);
+    }
+}
+
+void GB_line_compose(const BYTE *bg_ids, const BYTE *obj_ids, const BYTE *obj_attrs,
+                     BYTE bgp, BYTE obp0, BYTE obp1, BYTE *shades) {
+    for (int x = 0; x < GB_LINE_WIDTH; x++) {
+        BYTE id         = bg_ids[x];
+        BYTE palette    = bgp;
+
+        if ( obj_ids[x] && !( (obj_attrs[x] & GB_OBJ_ATTR_BG_PRIORITY) && id ) ) {
+            id          = obj_ids[x];
+            palette     = (obj_attrs[x] & GB_OBJ_ATTR_PALETTE) ? obp1 : obp0;
+        }
+
+        shades[x] = ( palette >> (id * 2) ) & 3;
+    }
+}
+
+#endif
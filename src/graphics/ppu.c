@@ -1,5 +1,7 @@
 #include "graphics/ppu.h"
+#include "graphics/line.h"
 #include "mmu.h"
+#include "memmap.h"
 #include "cpudef.h"
 #include "gb.h"
 #include "cpu/interrupt.h"
@@ -9,21 +11,19 @@
 #include <stdint.h>
 #include <string.h>
 
+#define REGS                        ( &gb->state.ppu.regs )
+
 /* LCD Control Register */
-#define LCDC                        ( GB_mem_read(gb, 0xFF40) )
-#define LCDC_LCD_EN                 ( LCDC >> 7 )
-#define LCDC_WIN_MAP                ( (LCDC >> 6) & 1 )
-#define LCDC_WIN_EN                 ( (LCDC >> 5) & 1 )
-#define LCDC_TILE_SEL               ( (LCDC >> 4) & 1 )
-#define LCDC_BG_MAP                 ( (LCDC >> 3) & 1 )
-#define LCDC_OBJ_SIZE               ( (LCDC >> 2) & 1 )
-#define LCDC_OBJ_EN                 ( (LCDC >> 1) & 1 )
-#define LCDC_BG_EN                  ( LCDC & 1 )            /* BG and WIN enable */
+#define LCDC                        ( REGS->lcdc )
+#define LCDC_LCD_EN                 ( REGS->lcd_en )
+#define LCDC_WIN_EN                 ( REGS->win_en )
+#define LCDC_OBJ_EN                 ( REGS->obj_en )
+#define LCDC_BG_EN                  ( REGS->bg_en )         /* BG and WIN enable */
 
 /* LCD Status Register */
-#define LY                          ( gb->io_regs[0x44] )
-#define LYC                         ( GB_mem_read(gb, 0xFF45) )
-#define STAT                        ( gb->io_regs[0x41] )
+#define LY                          ( gb->state.io_regs[0x44] )
+#define LYC                         ( REGS->lyc )
+#define STAT                        ( gb->state.io_regs[0x41] )
 #define LYC_INT                     ( (STAT >> 6) & 1 )
 #define MODE2_INT                   ( (STAT >> 5) & 1 )
 #define MODE1_INT                   ( (STAT >> 4) & 1 )
@@ -37,37 +37,37 @@
 #define PPU_MODE_DRAW       (3)
 
 /* Background Coordinates */
-#define SCY                         ( GB_mem_read(gb, 0xFF42) )
-#define SCX                         ( GB_mem_read(gb, 0xFF43) )
+#define SCY                         ( REGS->scy )
+#define SCX                         ( REGS->scx )
 
 /* Window Coordinates */
-#define WY                          ( GB_mem_read(gb, 0xFF4A) )
-#define WX                          ( GB_mem_read(gb, 0xFF4B) )
+#define WY                          ( REGS->wy )
+#define WX                          ( REGS->wx )
 #define SHOW_WIN                    ( LCDC_BG_EN && LCDC_WIN_EN && (WX - 7) <= LX && WY <= LY )
 
 /* LCD Monochrome Palettes */
-#define BGP                         ( GB_mem_read(gb, 0xFF47) )
-#define OBP0                        ( GB_mem_read(gb, 0xFF48) )
-#define OBP1                        ( GB_mem_read(gb, 0xFF49) )
+#define BGP                         ( REGS->bgp )
+#define OBP0                        ( REGS->obp[0] )
+#define OBP1                        ( REGS->obp[1] )
 
-#define SET_REGISTER_BIT(addr, value, pos, bit)     ( GB_mem_write(gb, addr, ( ( value & ( ~(1 << pos) ) ) ) | (1 << pos) ) )
-#define SET_LCDC(pos, bit)                          ( SET_REGISTER_BIT(0xFF40, LCDC, pos, bit) )
-#define SET_STAT(pos, bit)                          ( SET_REGISTER_BIT(0xFF41, STAT, pos, bit) )
+/* STAT bits driven by the PPU are read-only on the bus, they are stored directly */
+#define SET_REGISTER_BIT(reg, pos, bit)             ( reg = ( reg & ( ~(1 << pos) ) ) | (1 << pos) )
+#define SET_STAT(pos, bit)                          ( SET_REGISTER_BIT(STAT, pos, bit) )
 #define SET_PPU_MODE(mode) do {                                 \
-    GB_mem_write(gb, 0xFF41, ( STAT & 0xFC ) | (mode & 3) );    \
-    gb->ppu->m_ppu_mode_switched = 1;                           \
+    STAT = ( STAT & 0xFC ) | (mode & 3);                        \
+    gb->state.ppu.m_ppu_mode_switched = 1;                      \
 } while(0)
 
-#define PPU_MODE_SWITCHED                           ( gb->ppu->m_ppu_mode_switched + ( gb->ppu->m_ppu_mode_switched = 0) )
+#define PPU_MODE_SWITCHED                           ( gb->state.ppu.m_ppu_mode_switched + ( gb->state.ppu.m_ppu_mode_switched = 0) )
 
-#define LX                                          ( gb->ppu->lx                       )
-#define PENDING_CYCLES                              ( gb->ppu->pending_cycles           )
-#define SCANLINE_DOT_COUNTER                        ( gb->ppu->scanline_dot_counter     )
+#define LX                                          ( gb->state.ppu.lx                   )
+#define PENDING_CYCLES                              ( gb->state.ppu.pending_cycles       )
+#define SCANLINE_DOT_COUNTER                        ( gb->state.ppu.scanline_dot_counter )
 
-#define OAMBUFFER                                   ( gb->ppu->oam_buffer               )
+#define OAMBUFFER                                   ( &gb->state.ppu.oam_buffer          )
 
-#define BG_FETCHER                                  ( gb->ppu->bg_fetcher               )
-#define OBJ_FETCHER                                 ( gb->ppu->obj_fetcher              )
+#define BG_FETCHER                                  ( &gb->state.ppu.bg_fetcher          )
+#define OBJ_FETCHER                                 ( &gb->state.ppu.obj_fetcher         )
 
 #define FETCHER_GET_TILE_ID     (0)
 #define FETCHER_GET_DATA_LOW    (1)
@@ -84,6 +84,9 @@
 
 #define NB_RENDERED_PIXELS      ( LX - (SCX % 8) )
 
+/* Decoded tile rows */
+#define TILE_ROW_INDEX(addr)            ( ( (addr) - 0x8000 ) >> 1 )
+
 // Default values
 #define WINDOW_LINE_COUNTER_DEFAULT     (-1)
 #define SPRITE_TALL_LY_START_DEFAULT    (-1)
@@ -91,110 +94,46 @@
 #define OAM_END_ADDR                    (0xFE9F)
 #define PPU_MODE_SWITCHED_DEFAULT       (1)
 
-typedef struct PixelFIFO_Cell PixelFIFO_Cell;
-
-struct PixelFIFO_Cell {
-    BYTE color_id;
-    BYTE palette_id;
-    BYTE bg_priority;
-};
-
-typedef struct {
-    PixelFIFO_Cell  buffer[16];
-    int start;
-    int size;
-} PixelFIFO;
-
-struct OAMBuffer {
-    BYTE buffer[10];
-    int buf_size;
-    int cur_oam_addr;
-};
-
-struct PixelFetcher {
-    int             x;
-    int             y;
-    int             status;
-    BYTE            tile_id;
-    BYTE            tile_data_high;
-    BYTE            tile_data_low;
-    PixelFIFO      *fifo;
-
-    int             draw_window;
-    int             window_line_counter;
-
-    int             sprite_addr;
-    int             sprite_tall_ly_start;
-    int             last_sprite_x_end;
-};
-
-PixelFIFO* pixelfifo_create() {
-    PixelFIFO *fifo = (PixelFIFO*)( malloc( sizeof(PixelFIFO) ) );
-    fifo->start = 0;
-    fifo->size  = 0;
-
-    return fifo;
-}
-
-void pixelfifo_push(PixelFIFO *fifo, BYTE color_id, BYTE palette_id, BYTE bg_priority) { 
-    if ( fifo->size >= 16 ) return;
-
-    PixelFIFO_Cell cell;
-    cell.color_id          = color_id;
-    cell.palette_id        = palette_id;
-    cell.bg_priority       = bg_priority;
-
-    fifo->buffer[ ( fifo->start + fifo->size ) % 16 ] = cell;
-    fifo->size++;
+/// Mask of the fifo positions [start, end), 0 being the next pixel out
+static inline DWORD pixelfifo_span(int start, int end) {
+    if (start >= end) return 0;
+    return (DWORD)( ( 0xFFFFFFFFull >> (2 * start) ) & ~( 0xFFFFFFFFull >> (2 * end) ) );
 }
 
-void pixelfifo_overlap(PixelFIFO *fifo, BYTE color_id, BYTE palette_id, BYTE bg_priority, unsigned offset) {
-    if ( fifo->size >= 16 || offset >= fifo->size ) return;
-
-    PixelFIFO_Cell cell;
-    cell.color_id          = color_id;
-    cell.palette_id        = palette_id;
-    cell.bg_priority       = bg_priority;
+/**
+ * Push a decoded row of 8 pixels (see tile_rows) into the fifo. With an overlap offset, its first pixels land on the
+ * last ones already queued and only replace the transparent ones; the pixel about to go out is never replaced
+*/
+void pixelfifo_push_row(PixelFIFO *fifo, WORD row, BYTE palette_id, BYTE bg_priority, unsigned overlap_offset) {
+    int size    = fifo->size;
+    int start   = size - (int)overlap_offset;
+    int end     = start + 8 < 16 ? start + 8 : 16;
+    DWORD placed, opaque, mask;
 
-    int index = ( fifo->start + fifo->size - offset ) % 16;
+    if (size >= 16) return;
 
-    // Replace current cell if transparent
-    if (fifo->buffer[index].color_id == 0) {
-        fifo->buffer[index] = cell;
-    }
-}
+    placed  = (DWORD)( start >= 0 ? ( (uint64_t)row << 16 ) >> (2 * start) : (uint64_t)row << (16 - 2 * start) );
+    opaque  = ( fifo->color_ids | (fifo->color_ids >> 1) ) & 0x55555555;
+    opaque |= opaque << 1;
+    mask    = ( pixelfifo_span(start > 1 ? start : 1, size) & ~opaque ) | pixelfifo_span(size, end);
 
-/// Merge [high] and [low] to form a row of 8 pixels and push them into the fifo
-void pixelfifo_push_row(PixelFIFO *fifo, BYTE high, BYTE low, BYTE palette_id, BYTE bg_priority, int flip_x, unsigned overlap_offset) {
-    for ( int i = 0; i < 8; i++) {
-        int data;
-        
-        if (flip_x) {
-            data = ( ( high & 1 ) << 1 ) | ( ( low & 1 ) );
-            high >>= 1;
-            low  >>= 1;
-        } else {
-            data = ( ( high & 0x80 ) >> 6 ) | ( ( low & 0x80 ) >> 7 );
-            high <<= 1;
-            low  <<= 1;
-        }
+    fifo->color_ids     = ( fifo->color_ids     & ~mask ) | ( placed & mask );
+    fifo->palette_ids   = ( fifo->palette_ids   & ~mask ) | ( palette_id  ? mask : 0 );
+    fifo->bg_priorities = ( fifo->bg_priorities & ~mask ) | ( bg_priority ? mask : 0 );
 
-        if (overlap_offset) {  
-            pixelfifo_overlap( fifo, data, palette_id, bg_priority, overlap_offset-- );
-        } else {
-            pixelfifo_push( fifo, data, palette_id, bg_priority );
-        }
-    }
+    if (end > size) fifo->size = end;
 }
 
 int pixelfifo_pop(PixelFIFO *fifo, BYTE *color_id, BYTE *palette_id, BYTE *bg_priority) {
     if (!fifo->size) return -1;
 
-    if (color_id)       *color_id       = fifo->buffer[fifo->start].color_id;
-    if (palette_id)     *palette_id     = fifo->buffer[fifo->start].palette_id;
-    if (bg_priority)    *bg_priority    = fifo->buffer[fifo->start].bg_priority;
-     
-    fifo->start = ( fifo->start + 1 ) % 16;
+    if (color_id)       *color_id       = fifo->color_ids >> 30;
+    if (palette_id)     *palette_id     = fifo->palette_ids >> 31;
+    if (bg_priority)    *bg_priority    = fifo->bg_priorities >> 31;
+
+    fifo->color_ids     <<= 2;
+    fifo->palette_ids   <<= 2;
+    fifo->bg_priorities <<= 2;
     fifo->size--;
 
     return 0;
@@ -203,29 +142,19 @@ int pixelfifo_pop(PixelFIFO *fifo, BYTE *color_id, BYTE *palette_id, BYTE *bg_pr
 void pixelfifo_clear(PixelFIFO *fifo) {
     if (fifo == NULL) return;
 
-    fifo->start = 0;
-    fifo->size = 0;
-}
-
-void pixelfifo_destroy(PixelFIFO *fifo) {
-    pixelfifo_clear(fifo);
-
-    free(fifo);
+    fifo->color_ids     = 0;
+    fifo->palette_ids   = 0;
+    fifo->bg_priorities = 0;
+    fifo->size          = 0;
 }
 
 /// Check whether a fifo is less than 8 pixels
 static inline int pixelfifo_empty(PixelFIFO *fifo) { return fifo->size <= 8; }
 
-OAMBuffer* oambuffer_create() {
-    OAMBuffer *buffer               = (OAMBuffer*)( malloc( sizeof(OAMBuffer) ) );
+void oambuffer_init(OAMBuffer *buffer) {
+    memset((void*)buffer->buffer, 0, 10);
     buffer->buf_size                = 0;
     buffer->cur_oam_addr            = OAM_START_ADDR;
-
-    return buffer;
-}
-
-void oambuffer_destroy(OAMBuffer *buffer) {
-    if (buffer) free(buffer);
 }
 
 #define OAMBUFFER_CLEAR() do {                                  \
@@ -234,26 +163,18 @@ void oambuffer_destroy(OAMBuffer *buffer) {
     OAMBUFFER->buf_size = 0;                                    \
 } while(0)
 
-PixelFetcher* pixelfetcher_create() {
-    PixelFetcher *fetcher           = (PixelFetcher*)( malloc( sizeof(PixelFetcher) ) );
+void pixelfetcher_init(PixelFetcher *fetcher) {
     fetcher->status                 = 0;
     fetcher->x                      = 0;
     fetcher->y                      = 0;
-    fetcher->fifo                   = pixelfifo_create();
+    fetcher->tile_id                = 0;
+    fetcher->tile_row               = 0;
+    pixelfifo_clear(&fetcher->fifo);
     fetcher->draw_window            = 0;
     fetcher->window_line_counter    = WINDOW_LINE_COUNTER_DEFAULT;
     fetcher->sprite_addr            = 0;
     fetcher->last_sprite_x_end      = 0;
     fetcher->sprite_tall_ly_start   = SPRITE_TALL_LY_START_DEFAULT;
-
-    return fetcher;
-}
-
-void pixelfetcher_destroy(PixelFetcher *fetcher) {
-    if (fetcher == NULL) return;
-
-    pixelfifo_destroy(fetcher->fifo); 
-    free(fetcher);
 }
 
 BYTE GB_ppu_vram_read(GB_ppu_t *ppu, WORD addr) {
@@ -266,6 +187,32 @@ BYTE GB_ppu_vram_read(GB_ppu_t *ppu, WORD addr) {
     return ppu->vram[addr];
 }
 
+/// Spreads the 8 bits of b over the even bits of a word
+static WORD spread_bits(BYTE b) {
+    WORD w = b;
+
+    w = ( w | (w << 4) ) & 0x0F0F;
+    w = ( w | (w << 2) ) & 0x3333;
+    w = ( w | (w << 1) ) & 0x5555;
+    return w;
+}
+
+static BYTE reverse_bits(BYTE b) {
+    b = (BYTE)( ( (b & 0xF0) >> 4 ) | ( (b & 0x0F) << 4 ) );
+    b = (BYTE)( ( (b & 0xCC) >> 2 ) | ( (b & 0x33) << 2 ) );
+    b = (BYTE)( ( (b & 0xAA) >> 1 ) | ( (b & 0x55) << 1 ) );
+    return b;
+}
+
+/// Decodes the row made of its two bitplanes, low then high byte
+static void tile_row_decode(GB_ppu_t *ppu, int index) {
+    BYTE low    = ppu->vram[2 * index];
+    BYTE high   = ppu->vram[2 * index + 1];
+
+    ppu->tile_rows[index]           = spread_bits(low) | ( spread_bits(high) << 1 );
+    ppu->tile_rows_flipped[index]   = spread_bits(reverse_bits(low)) | ( spread_bits(reverse_bits(high)) << 1 );
+}
+
 void GB_ppu_vram_write(GB_ppu_t *ppu, WORD addr, BYTE data) {
     if (addr < 0x8000 || addr >= 0xA000) {
         fprintf(stderr, "VRAM WRITE OUT OF RANGE\n");
@@ -274,6 +221,8 @@ void GB_ppu_vram_write(GB_ppu_t *ppu, WORD addr, BYTE data) {
 
     addr = ( addr - 0x8000 ) & 0x1FFF;
     ppu->vram[addr] = data;
+
+    if (addr < 2 * GB_TILE_ROWS) tile_row_decode(ppu, addr >> 1);
 }
 
 BYTE GB_ppu_oam_read(GB_ppu_t *ppu, WORD addr) {
@@ -295,56 +244,27 @@ void GB_ppu_oam_write(GB_ppu_t *ppu, WORD addr, BYTE data) {
     ppu->oam[addr] = data;
 }
 
-GB_ppu_t* GB_ppu_create(int headless) {
-    GB_ppu_t *ppu = (GB_ppu_t*)( malloc( sizeof(GB_ppu_t) ) );
+void GB_ppu_init(GB_ppu_t *ppu) {
+    memset((void*)ppu->vram, 0, GB_VRAM_SIZE);
+    memset((void*)ppu->oam, 0, GB_OAM_SIZE);
+    memset((void*)ppu->tile_rows, 0, sizeof ppu->tile_rows);
+    memset((void*)ppu->tile_rows_flipped, 0, sizeof ppu->tile_rows_flipped);
 
-    if (!ppu) {
-        return NULL;
-    }
-
-    ppu->vram = (BYTE*)( calloc( 0x2000+1, sizeof (BYTE) ) );
-    if (!ppu->vram) {
-        free(ppu);
-        return NULL;
-    }
-
-    ppu->oam = (BYTE*)( calloc( 161, sizeof (BYTE) ) );
-    if (!ppu->oam) {
-        free(ppu->vram);
-        free(ppu);
-        return NULL;
-    }
-
-    ppu->oam_buffer                 = oambuffer_create();
-    ppu->bg_fetcher                 = pixelfetcher_create();
-    ppu->obj_fetcher                = pixelfetcher_create();
-    ppu->lcd                        = headless ? NULL : GB_lcd_create();
+    oambuffer_init(&ppu->oam_buffer);
+    pixelfetcher_init(&ppu->bg_fetcher);
+    pixelfetcher_init(&ppu->obj_fetcher);
+    ppu->fetch_obj                  = 0;
     ppu->lx                         = 0;
     ppu->pending_cycles             = 0;
     ppu->scanline_dot_counter       = 0;
     ppu->m_ppu_mode_switched        = PPU_MODE_SWITCHED_DEFAULT;
-
-    if ( (!headless && ppu->lcd == NULL) ||
-          !ppu->oam_buffer  ||
-          !ppu->bg_fetcher  || 
-          !ppu->obj_fetcher) {
-        GB_ppu_destroy(ppu);
-        return NULL;
-    }
-
-    return ppu;
-}
-
-void GB_ppu_destroy(GB_ppu_t *ppu) {
-    if (ppu == NULL) return;
-
-    oambuffer_destroy(ppu->oam_buffer);
-    pixelfetcher_destroy(ppu->bg_fetcher);
-    pixelfetcher_destroy(ppu->obj_fetcher);
-    GB_lcd_destroy(ppu->lcd);
-    if (ppu->oam) free(ppu->oam);
-    if (ppu->vram) free(ppu->vram);
-    free(ppu);
+    ppu->last_sync                  = 0;
+    ppu->fast_line                  = 0;
+    ppu->fast_line_end              = 0;
+    ppu->fast_line_pending          = 0;
+    ppu->skip_frame                 = 0;
+    ppu->skipped_frames             = 0;
+    memset((void*)&ppu->regs, 0, sizeof ppu->regs);
 }
 
 void pixelfetcher_get_tile_id(GB_gameboy_t *gb) {
@@ -357,59 +277,50 @@ void pixelfetcher_get_tile_id(GB_gameboy_t *gb) {
     }
 
     if (SHOW_WIN) {
-        tilemap =  LCDC_WIN_MAP ? 0x9C00 : 0x9800;
+        tilemap = REGS->win_map;
         x       = BG_FETCHER->x & 0x1F;
         y       = BG_FETCHER->window_line_counter;
     } else {
-        tilemap = LCDC_BG_MAP ? 0x9C00 : 0x9800;
+        tilemap = REGS->bg_map;
         x       = ( ( SCX / 8 ) + BG_FETCHER->x ) & 0x1F;
         y       = ( LY + SCY ) & 0xFF; 
     }
 
     offset  = ( x + 32 * ( y / 8 ) );
 
-    BG_FETCHER->tile_id = GB_ppu_vram_read(gb->ppu, tilemap+offset);
+    BG_FETCHER->tile_id = GB_ppu_vram_read(&gb->state.ppu, tilemap+offset);
     BG_FETCHER->x++;
     BG_FETCHER->y = y;
 }
 
-BYTE pixelfetcher_get_tile_data(GB_gameboy_t *gb, int high) {
-    int addr = 0x8000;
-    int tile_id = BG_FETCHER->tile_id;
+WORD pixelfetcher_get_tile_row(GB_gameboy_t *gb) {
+    int addr    = REGS->tile_data;
+    int tile_id = REGS->signed_tiles ? (SIGNED_BYTE)BG_FETCHER->tile_id : BG_FETCHER->tile_id;
     int offset  = SHOW_WIN ? BG_FETCHER->window_line_counter : LY + SCY;
 
     if (!LCDC_BG_EN) {
-        return 0x00;
-    }
-
-    high = high ? 1 : 0;
-
-    if ( !LCDC_TILE_SEL ) {
-        addr = 0x9000;
-        tile_id = (SIGNED_BYTE)tile_id;
+        return 0x0000;
     }
 
-    return GB_ppu_vram_read(gb->ppu, addr + tile_id*16 + high + 2 * (offset%8) );
+    return gb->state.ppu.tile_rows[TILE_ROW_INDEX( addr + tile_id*16 + 2 * (offset%8) )];
 }
 
 void pixelfetcher_push(GB_gameboy_t *gb) {
-    if (pixelfifo_empty(BG_FETCHER->fifo)) {
-        pixelfifo_push_row( BG_FETCHER->fifo, 
-                            BG_FETCHER->tile_data_high, 
-                            BG_FETCHER->tile_data_low,
-                            0, 0, 0, 0 );
+    if (pixelfifo_empty(&BG_FETCHER->fifo)) {
+        pixelfifo_push_row( &BG_FETCHER->fifo, 
+                            BG_FETCHER->tile_row,
+                            0, 0, 0 );
         BG_FETCHER->status=0;
     }
 }
 
 #define PIXEL_FETCHER_RESET(fetcher) do {                                           \
-    pixelfifo_clear(fetcher->fifo);                                                 \
+    pixelfifo_clear(&fetcher->fifo);                                                \
     fetcher->x                      = 0;                                            \
     fetcher->y                      = 0;                                            \
     fetcher->status                 = 0;                                            \
     fetcher->tile_id                = 0;                                            \
-    fetcher->tile_data_low          = 0;                                            \
-    fetcher->tile_data_high         = 0;                                            \
+    fetcher->tile_row               = 0;                                            \
     fetcher->sprite_addr            = 0;                                            \
     fetcher->last_sprite_x_end      = 0;                                            \
 } while(0)
@@ -425,11 +336,10 @@ void bg_fetch(GB_gameboy_t *gb) {
         case FETCHER_GET_TILE_ID: 
             pixelfetcher_get_tile_id(gb);
             break;
-        case FETCHER_GET_DATA_LOW:
-            BG_FETCHER->tile_data_low = pixelfetcher_get_tile_data(gb, 0);
+        case FETCHER_GET_DATA_LOW: /* Both bitplanes come decoded with the high one */
             break;
         case FETCHER_GET_DATA_HIGH:
-            BG_FETCHER->tile_data_high = pixelfetcher_get_tile_data(gb, 1);
+            BG_FETCHER->tile_row = pixelfetcher_get_tile_row(gb);
             break;
         default: /* Try push */
             pixelfetcher_push(gb);
@@ -444,7 +354,7 @@ void sprite_fetch(GB_gameboy_t *gb) {
     int i = 0;
     while (!OBJ_FETCHER->sprite_addr && i < OAMBUFFER->buf_size) {
         WORD addr = 0xFE00 | OAMBUFFER->buffer[i];
-        if ( addr <= 0xFE9F && ( GB_ppu_oam_read(gb->ppu, addr+1) <= ( LX + 8 ) ) ) {
+        if ( addr <= 0xFE9F && ( GB_ppu_oam_read(&gb->state.ppu, addr+1) <= ( LX + 8 ) ) ) {
             OBJ_FETCHER->sprite_addr = addr;
             OAMBUFFER->buffer[i] = 0xFF;
             break;
@@ -456,7 +366,7 @@ void sprite_fetch(GB_gameboy_t *gb) {
     if (!OBJ_FETCHER->sprite_addr || PENDING_CYCLES++ < 2) return;
     PENDING_CYCLES-=2;
 
-    BYTE attr   = GB_ppu_oam_read(gb->ppu, OBJ_FETCHER->sprite_addr+3);
+    BYTE attr   = GB_ppu_oam_read(&gb->state.ppu, OBJ_FETCHER->sprite_addr+3);
     BYTE flip_y = ( attr >> 6 ) & 1;
     int offset  = ( LY + SCY ) % 8;
 
@@ -468,9 +378,9 @@ void sprite_fetch(GB_gameboy_t *gb) {
 
     switch (OBJ_FETCHER->status++) {
         case FETCHER_GET_TILE_ID:
-            OBJ_FETCHER->tile_id = GB_ppu_oam_read(gb->ppu, OBJ_FETCHER->sprite_addr+2);
+            OBJ_FETCHER->tile_id = GB_ppu_oam_read(&gb->state.ppu, OBJ_FETCHER->sprite_addr+2);
 
-            if (LCDC_OBJ_SIZE) {
+            if (REGS->obj_height == 16) {
                 // Check if fetch new 8x16 sprite
                 if (OBJ_FETCHER->sprite_tall_ly_start < 0) {
                     OBJ_FETCHER->sprite_tall_ly_start = LY;
@@ -488,30 +398,26 @@ void sprite_fetch(GB_gameboy_t *gb) {
                 }
             }
             break;
-        case FETCHER_GET_DATA_LOW:
-            OBJ_FETCHER->tile_data_low  = GB_ppu_vram_read(gb->ppu, 0x8000 + OBJ_FETCHER->tile_id*16     + offset );
+        case FETCHER_GET_DATA_LOW: /* Both bitplanes come decoded with the high one */
             break;
-        case FETCHER_GET_DATA_HIGH:
-            OBJ_FETCHER->tile_data_high = GB_ppu_vram_read(gb->ppu, 0x8000 + OBJ_FETCHER->tile_id*16 + 1 + offset );
+        case FETCHER_GET_DATA_HIGH: {
+            const WORD *rows = ( attr & 0x20 ) ? gb->state.ppu.tile_rows_flipped : gb->state.ppu.tile_rows;
+            OBJ_FETCHER->tile_row = rows[TILE_ROW_INDEX( 0x8000 + OBJ_FETCHER->tile_id*16 + offset )];
+        }
             break;
         default: {
             BYTE palette    = ( attr >> 4 ) & 1;
             BYTE priority   = ( attr >> 7 ) & 1;
-            BYTE flip_x     = ( attr >> 5 ) & 1;
-            BYTE data_high  = OBJ_FETCHER->tile_data_high;
-            BYTE data_low   = OBJ_FETCHER->tile_data_low;
 
             int overlap_offset = 0;
             if (LX < OBJ_FETCHER->last_sprite_x_end) {
                 overlap_offset = OBJ_FETCHER->last_sprite_x_end - LX;
             }
 
-            pixelfifo_push_row( OBJ_FETCHER->fifo, 
-                                data_high, 
-                                data_low,
+            pixelfifo_push_row( &OBJ_FETCHER->fifo, 
+                                OBJ_FETCHER->tile_row,
                                 palette,
                                 priority,
-                                flip_x,
                                 overlap_offset );
 
             OBJ_FETCHER->sprite_addr        = 0;
@@ -523,20 +429,20 @@ void sprite_fetch(GB_gameboy_t *gb) {
 }
 
 void ppu_render(GB_gameboy_t *gb) {
-    if (pixelfifo_empty(BG_FETCHER->fifo)) return;
+    if (pixelfifo_empty(&BG_FETCHER->fifo)) return;
 
-    BYTE color_id, bg_priority;
+    BYTE color_id = 0, bg_priority = 0;
     BYTE palette, color_index;
 
-    pixelfifo_pop(BG_FETCHER->fifo, &color_id, NULL, &bg_priority);
+    pixelfifo_pop(&BG_FETCHER->fifo, &color_id, NULL, &bg_priority);
     palette = BGP;
     
-    if (OBJ_FETCHER->fifo->size > 0) {
+    if (OBJ_FETCHER->fifo.size > 0) {
         BYTE cid, pid, bgp;
-        pixelfifo_pop(OBJ_FETCHER->fifo, &cid, &pid, &bgp);
+        pixelfifo_pop(&OBJ_FETCHER->fifo, &cid, &pid, &bgp);
 
         if ( cid && !( bgp && color_id ) ) {
-            palette = GB_mem_read(gb, 0xFF48+pid);
+            palette = REGS->obp[pid];
             color_id = cid;
         }
     }
@@ -547,9 +453,9 @@ void ppu_render(GB_gameboy_t *gb) {
     // maximum of 6 bits shifted
     color_index = ( palette >> (color_id * 2) ) & 3;
 
-    // BG Scrolling penality
-    if ( LX >= (SCX % 8) ) {
-        GB_lcd_set_pixel(gb->ppu->lcd, NB_RENDERED_PIXELS, LY, color_index);
+    // BG Scrolling penality. A skipped frame goes through the same steps, only its pixels are left out
+    if ( LX >= (SCX % 8) && !gb->state.ppu.skip_frame ) {
+        GB_lcd_set_pixel(gb->lcd, NB_RENDERED_PIXELS, LY, color_index);
     }
 
     LX++;
@@ -560,6 +466,147 @@ void ppu_render(GB_gameboy_t *gb) {
     } 
 }
 
+/*=============== SCANLINE RENDERER ===============*/
+
+#define DRAW_MIN_DOTS           (172)
+#define DRAW_MAX_DOTS           (289)
+#define OAMSEARCH_DOTS          (80)
+#define SCREEN_WIDTH            (160)
+
+/**
+ * Mode 3 length as described by Pan Docs: 172 dots, the pixels of SCX dropped in the first tile, 6 when the window
+ * starts and 6 per object, plus up to 5 for the first object met in a background tile depending on its alignment
+*/
+static int draw_length(GB_gameboy_t *gb) {
+    BYTE lcdc       = LCDC;
+    BYTE scx        = SCX;
+    int length      = DRAW_MIN_DOTS + (scx & 7);
+    uint32_t tiles  = 0;                        // Background tiles an object was already fetched in
+
+    if ( (lcdc & 0x21) == 0x21 && WY <= LY && WX <= SCREEN_WIDTH + 6 ) length += 6;
+
+    for (int i = 0; (lcdc & 2) && i < OAMBUFFER->buf_size; i++) {
+        int x       = gb->state.ppu.oam[OAMBUFFER->buffer[i] + 1];
+        int tile    = ( x + (scx & 7) ) >> 3;
+        int align   = ( x + scx ) & 7;
+
+        length += 6;
+        if ( !( tiles & (1u << tile) ) ) {
+            tiles  |= 1u << tile;
+            length += align < 5 ? 5 - align : 0;
+        }
+    }
+
+    return length < DRAW_MAX_DOTS ? length : DRAW_MAX_DOTS;
+}
+
+/// Color ids of a span of background or window pixels, src_x/src_y being coordinates in the 256x256 tile map
+static void draw_tiles(const GB_ppu_t *ppu, BYTE lcdc, int map, int x, int end, int src_x, int src_y, BYTE *ids) {
+    WORD rows[GB_LINE_WIDTH / 8 + 1];
+    BYTE tile_ids[sizeof rows / sizeof *rows * 8];
+    int count = ( (src_x & 7) + end - x + 7 ) >> 3;
+    const BYTE *tiles = ppu->vram + map + 32 * ( (src_y & 0xFF) >> 3 );
+
+    if (x >= end) return;
+
+    for (int i = 0; i < count; i++) {
+        int tile_id = tiles[( (src_x >> 3) + i ) & 0x1F];
+        int addr    = (lcdc & 0x10) ? 0x8000 + tile_id * 16 : 0x9000 + (SIGNED_BYTE)tile_id * 16;
+
+        rows[i]     = ppu->tile_rows[TILE_ROW_INDEX( addr + 2 * (src_y & 7) )];
+    }
+
+    GB_line_decode(rows, count, tile_ids);
+    memcpy(ids + x, tile_ids + (src_x & 7), end - x);
+}
+
+/// Whole line from the registers as they are at the end of Mode 3
+static void draw_line(GB_gameboy_t *gb) {
+    const GB_ppu_t *ppu = &gb->state.ppu;
+    const BYTE *oam     = ppu->oam;
+    BYTE lcdc           = LCDC;
+    BYTE bgp            = BGP;
+    BYTE obp[2]         = { OBP0, OBP1 };
+    int ly              = LY;
+    int win_x           = SCREEN_WIDTH;
+
+    BYTE bg_ids[SCREEN_WIDTH];
+    BYTE obj_ids[SCREEN_WIDTH];
+    BYTE obj_attrs[SCREEN_WIDTH];
+    BYTE shades[SCREEN_WIDTH];
+
+    memset(bg_ids,      0, sizeof bg_ids);
+    memset(obj_ids,     0, sizeof obj_ids);
+    memset(obj_attrs,   0, sizeof obj_attrs);
+
+    if (lcdc & 1) {
+        if ( (lcdc & 0x20) && WY <= ly && WX <= SCREEN_WIDTH + 6 ) win_x = WX < 7 ? 0 : WX - 7;
+
+        draw_tiles(ppu, lcdc, (lcdc & 0x08) ? 0x1C00 : 0x1800, 0, win_x, SCX, ly + SCY, bg_ids);
+        draw_tiles(ppu, lcdc, (lcdc & 0x40) ? 0x1C00 : 0x1800, win_x, SCREEN_WIDTH, win_x + 7 - WX, BG_FETCHER->window_line_counter, bg_ids);
+    }
+
+    if (lcdc & 2) {
+        BYTE order[10];
+        int count = OAMBUFFER->buf_size;
+        int height = (lcdc & 4) ? 16 : 8;
+
+        // Lower X first then lower OAM address, the buffer holds the latter order
+        for (int i = 0; i < count; i++) {
+            int j = i;
+            for (; j > 0 && oam[order[j - 1] + 1] > oam[OAMBUFFER->buffer[i] + 1]; j--) order[j] = order[j - 1];
+            order[j] = OAMBUFFER->buffer[i];
+        }
+
+        // Lowest priority first, an opaque pixel of a higher priority object then overwrites it
+        while (count--) {
+            const BYTE *obj = &oam[order[count]];
+            int row         = ly + 16 - obj[0];
+            int tile_id     = height == 16 ? obj[2] & 0xFE : obj[2];
+
+            if (obj[3] & 0x40) row = height - 1 - row;
+
+            BYTE ids[8];
+            GB_line_decode(&( (obj[3] & 0x20) ? ppu->tile_rows_flipped : ppu->tile_rows )[tile_id * 8 + row], 1, ids);
+
+            for (int i = 0; i < 8; i++) {
+                int x = obj[1] - 8 + i;
+
+                if (x >= 0 && x < SCREEN_WIDTH && ids[i]) {
+                    obj_ids[x]      = ids[i];
+                    obj_attrs[x]    = obj[3];
+                }
+            }
+        }
+    }
+
+    GB_line_compose(bg_ids, obj_ids, obj_attrs, bgp, obp[0], obp[1], shades);
+    GB_lcd_set_line(gb->lcd, ly, shades);
+}
+
+/// Leaves the line about to enter Mode 3 to the scanline renderer when enabled
+static void fast_line_begin(GB_gameboy_t *gb) {
+    GB_ppu_t *ppu = &gb->state.ppu;
+
+    ppu->fast_line = gb->scanline_renderer;
+
+    if (ppu->fast_line) {
+        ppu->fast_line_end      = SCANLINE_DOT_COUNTER + draw_length(gb);
+        ppu->fast_line_pending  = PENDING_CYCLES;
+    }
+}
+
+/// Mode 3 of a line left to the scanline renderer only counts dots, the line is drawn at once on the last one
+static void fast_line_draw(GB_gameboy_t *gb) {
+    (void)PPU_MODE_SWITCHED; // Nothing to start, lets the PPU sleep
+
+    if (++SCANLINE_DOT_COUNTER >= gb->state.ppu.fast_line_end) {
+        if (gb->lcd && !gb->state.ppu.skip_frame) draw_line(gb);
+        gb->state.ppu.fast_line = 0;
+        SET_PPU_MODE(PPU_MODE_HBLANK);
+    }
+}
+
 void ppu_oamsearch(GB_gameboy_t *gb) {
     if ( PPU_MODE_SWITCHED ) {
         OAMBUFFER_CLEAR();
@@ -573,12 +620,12 @@ void ppu_oamsearch(GB_gameboy_t *gb) {
     }
 
     if (LCDC_OBJ_EN && OAMBUFFER->buf_size < 10 && OAMBUFFER->cur_oam_addr < OAM_END_ADDR && PENDING_CYCLES++ >= 2) {
-        BYTE y = GB_ppu_oam_read(gb->ppu, OAMBUFFER->cur_oam_addr);
-        BYTE x = GB_ppu_oam_read(gb->ppu, OAMBUFFER->cur_oam_addr+1);
+        BYTE y = GB_ppu_oam_read(&gb->state.ppu, OAMBUFFER->cur_oam_addr);
+        BYTE x = GB_ppu_oam_read(&gb->state.ppu, OAMBUFFER->cur_oam_addr+1);
 
         if (x > 0 && 
             ( LY + 16 ) >= y &&
-            ( LY + 16 ) < ( y + (LCDC_OBJ_SIZE+1) * 8 ) ) {
+            ( LY + 16 ) < ( y + REGS->obj_height ) ) {
             OAMBUFFER->buffer[OAMBUFFER->buf_size++] = OAMBUFFER->cur_oam_addr & 0xFF;
         }
 
@@ -592,10 +639,17 @@ void ppu_oamsearch(GB_gameboy_t *gb) {
         if (WY <= LY && WX-7 <= 160) {
             BG_FETCHER->window_line_counter++;
         }
+
+        fast_line_begin(gb);
     }
 }
 
 void ppu_draw(GB_gameboy_t *gb) {
+    if (gb->state.ppu.fast_line) {
+        fast_line_draw(gb);
+        return;
+    }
+
     sprite_fetch(gb);
 
     if (!OBJ_FETCHER->sprite_addr) {
@@ -640,8 +694,14 @@ void ppu_vblank(GB_gameboy_t *gb) {
             REQUEST_INTERRUPT(IF_LCD);
         }
 
-        GB_lcd_clear(gb->ppu->lcd);
-        GB_lcd_render(gb->ppu->lcd);
+        if (!gb->state.ppu.skip_frame) {
+            GB_lcd_clear(gb->lcd);
+            GB_lcd_render(gb->lcd);
+        }
+
+        // Decides for the next frame
+        gb->state.ppu.skip_frame        = gb->state.ppu.skipped_frames < gb->frame_skip;
+        gb->state.ppu.skipped_frames    = gb->state.ppu.skip_frame ? gb->state.ppu.skipped_frames + 1 : 0;
 
         BG_FETCHER->window_line_counter = WINDOW_LINE_COUNTER_DEFAULT;
     }
@@ -672,24 +732,135 @@ void ppu_vblank(GB_gameboy_t *gb) {
     SCANLINE_DOT_COUNTER++;
 }
 
+static void ppu_dot(GB_gameboy_t *gb) {
+    PENDING_CYCLES++;
+    switch (PPU_MODE) {
+        case PPU_MODE_HBLANK:       ppu_hblank(gb);     break;  // 87-204 dots
+        case PPU_MODE_VBLANK:       ppu_vblank(gb);     break;  // 456 * 10 = 4560 dots
+        case PPU_MODE_OAMSEARCH:    ppu_oamsearch(gb);  break;  // 80 dots
+        case PPU_MODE_DRAW:         ppu_draw(gb);       break;  // 172-289 dots
+    }
+}
+
+/**
+ * Dots ahead that only move the dot counter, up to the one with the next transition: the rest of an HBlank, of a VBlank
+ * scanline, of an OAM scan with nothing left to find or of a Mode 3 left to the scanline renderer
+*/
+static int ppu_quiet_dots(GB_gameboy_t *gb) {
+    if (gb->state.ppu.m_ppu_mode_switched) return 0;
+
+    switch (PPU_MODE) {
+        case PPU_MODE_OAMSEARCH:
+            // Objects off, buffer full or every entry read. OAM is not synced on writes, a scan in progress goes dot by dot
+            if (LCDC_OBJ_EN && OAMBUFFER->buf_size < 10 && OAMBUFFER->cur_oam_addr < OAM_END_ADDR) return 0;
+            return SCANLINE_DOT_COUNTER < OAMSEARCH_DOTS - 1 ? OAMSEARCH_DOTS - 1 - SCANLINE_DOT_COUNTER : 0;
+        case PPU_MODE_DRAW:
+            return gb->state.ppu.fast_line && SCANLINE_DOT_COUNTER < gb->state.ppu.fast_line_end - 1 ? gb->state.ppu.fast_line_end - 1 - SCANLINE_DOT_COUNTER : 0;
+        case PPU_MODE_HBLANK:
+            return SCANLINE_DOT_COUNTER < PPU_DOTS_PER_SCANLINE - 1 ? PPU_DOTS_PER_SCANLINE - 1 - SCANLINE_DOT_COUNTER : 0;
+        case PPU_MODE_VBLANK:
+            return SCANLINE_DOT_COUNTER && SCANLINE_DOT_COUNTER < PPU_DOTS_PER_SCANLINE ? PPU_DOTS_PER_SCANLINE - SCANLINE_DOT_COUNTER : 0;
+        default:
+            return 0;
+    }
+}
+
+void GB_ppu_sync(GB_gameboy_t *gb) {
+    uint64_t dots = ( gb->state.cpu.t_cycle_counter - gb->state.ppu.last_sync ) / 4 * 4;
+    gb->state.ppu.last_sync = gb->state.cpu.t_cycle_counter;
+
+    // LCDC only changes after a sync, the LCD was in the same state for all these cycles
+    if (!LCDC_LCD_EN) return;
+
+    while (dots) {
+        uint64_t quiet = ppu_quiet_dots(gb);
+
+        if (quiet) {
+            if (quiet > dots) quiet = dots;
+            SCANLINE_DOT_COUNTER    += quiet;
+            PENDING_CYCLES          += quiet;
+            dots                    -= quiet;
+        } else {
+            ppu_dot(gb);
+            dots--;
+        }
+    }
+}
+
+/**
+ * The FIFO reads the registers while drawing, the scanline renderer only at the end of Mode 3.
+ * Before a write lands in the middle of a line it renders, the FIFO replays that line up to now with the values
+ * still in place then draws the rest of it
+*/
+static void register_sync(GB_gameboy_t *gb) {
+    GB_ppu_t *ppu = &gb->state.ppu;
+
+    GB_ppu_sync(gb);
+
+    // Nothing gets drawn in a skipped frame, its lines keep their computed length
+    if (!ppu->fast_line || PPU_MODE != PPU_MODE_DRAW || ppu->skip_frame) return;
+
+    int dot = SCANLINE_DOT_COUNTER;
+
+    ppu->fast_line          = 0;
+    SCANLINE_DOT_COUNTER    = OAMSEARCH_DOTS;
+    PENDING_CYCLES          = ppu->fast_line_pending;
+
+    while (SCANLINE_DOT_COUNTER < dot) ppu_dot(gb);
+
+    GB_SCHEDULE_ASAP(gb, GB_EVENT_PPU); // Was sleeping until the end of Mode 3
+}
+
+void GB_ppu_register_write(GB_gameboy_t *gb, WORD addr, BYTE data) {
+    GB_ppu_regs_t *regs = REGS;
+
+    // LYC is only compared when a line starts, STAT and LY are not decoded
+    if (addr != GB_STAT_ADDR && addr != GB_LY_ADDR && addr != GB_LYC_ADDR) register_sync(gb);
+
+    switch (addr) {
+        case GB_LCDC_ADDR:
+            regs->lcdc          = data;
+            regs->lcd_en        = (data >> 7) & 1;
+            regs->win_map       = (data & 0x40) ? 0x9C00 : 0x9800;
+            regs->win_en        = (data >> 5) & 1;
+            regs->signed_tiles  = !(data & 0x10);
+            regs->tile_data     = (data & 0x10) ? 0x8000 : 0x9000;
+            regs->bg_map        = (data & 0x08) ? 0x9C00 : 0x9800;
+            regs->obj_height    = (data & 0x04) ? 16 : 8;
+            regs->obj_en        = (data >> 1) & 1;
+            regs->bg_en         = data & 1;
+            break;
+        case GB_SCY_ADDR:   regs->scy       = data; break;
+        case GB_SCX_ADDR:   regs->scx       = data; break;
+        case GB_LYC_ADDR:   regs->lyc       = data; break;
+        case GB_BGP_ADDR:   regs->bgp       = data; break;
+        case GB_OBP0_ADDR:  regs->obp[0]    = data; break;
+        case GB_OBP1_ADDR:  regs->obp[1]    = data; break;
+        case GB_WY_ADDR:    regs->wy        = data; break;
+        case GB_WX_ADDR:    regs->wx        = data; break;
+        default: break;
+    }
+}
+
+int GB_ppu_oam_idle(GB_gameboy_t *gb, int m_cycles) {
+    // LCDC only changes after a sync
+    if (!LCDC_LCD_EN) return 1;
+
+    // A sleeping PPU may be one scanline behind, hence the line left out
+    return PPU_MODE == PPU_MODE_VBLANK && ( MAX_LY - 1 - LY ) * PPU_DOTS_PER_SCANLINE >= 4 * m_cycles;
+}
+
 void GB_ppu_tick(GB_gameboy_t *gb, int cycles) {
     // TODO: Move lcd enable check in draw mode. Enabling or disabling LCD should only affect drawing, not ppu modes
-    if (!LCDC_LCD_EN || gb == NULL || gb->ppu == NULL) return;
-    int dot_cnt, mode;
-
-    for ( int i = 0; i < 4; i++) {
-        dot_cnt = SCANLINE_DOT_COUNTER;
-        mode = PPU_MODE;
-        PENDING_CYCLES++;
-        switch (PPU_MODE) {
-            case PPU_MODE_HBLANK:       ppu_hblank(gb);     break;  // 87-204 dots
-            case PPU_MODE_VBLANK:       ppu_vblank(gb);     break;  // 456 * 10 = 4560 dots
-            case PPU_MODE_OAMSEARCH:    ppu_oamsearch(gb);  break;  // 80 dots
-            case PPU_MODE_DRAW:         ppu_draw(gb);       break;  // 172-289 dots
-        }
+    if (gb == NULL) return;
 
-        if (dot_cnt == SCANLINE_DOT_COUNTER) {
-            fprintf(stderr, "DOT ERROR: %d\n", mode);
-        }
+    GB_ppu_sync(gb);
+
+    if (!LCDC_LCD_EN) {
+        GB_UNSCHEDULE(gb, GB_EVENT_PPU); // Woken up by LCDC writes
+        return;
     }
+
+    // Sleeps through HBlank and VBlank scanlines
+    GB_SCHEDULE_IN(gb, GB_EVENT_PPU, ppu_quiet_dots(gb) / 4 + 1);
 }
@@ -14,6 +14,51 @@ void intHandler(int dummy) {
     isrunning = 0;
 }
 
+/// Comma-separated [bank:]addr list, in hex. Bank defaults to 0 below 4000, 1 above
+static int parse_breakpoints(GB_gameboy_t *gb, const char *list) {
+    while (*list) {
+        unsigned bank, addr;
+        int len;
+
+        if (sscanf(list, "%x:%x%n", &bank, &addr, &len) != 2) {
+            if (sscanf(list, "%x%n", &addr, &len) != 1) return -1;
+            bank = addr >= 0x4000;
+        }
+
+        if (addr > 0xFFFF || GB_debugger_set_breakpoint(gb->debugger, (int)bank, (WORD)addr, 1)) return -1;
+
+        list += len;
+        if (*list == ',') list++;
+        else if (*list) return -1;
+    }
+
+    return 0;
+}
+
+/// Comma-separated addr[:r|w|rw] list, in hex. Both accesses by default
+static int parse_watchpoints(GB_gameboy_t *gb, const char *list) {
+    while (*list) {
+        unsigned addr;
+        int len, access = 0;
+
+        if (sscanf(list, "%x%n", &addr, &len) != 1 || addr > 0xFFFF) return -1;
+        list += len;
+
+        if (*list == ':') {
+            for (list++; *list == 'r' || *list == 'w'; list++) {
+                access |= *list == 'r' ? GB_WATCH_READ : GB_WATCH_WRITE;
+            }
+        }
+
+        GB_debugger_set_watchpoint(gb, (WORD)addr, access ? access : GB_WATCH_READ | GB_WATCH_WRITE);
+
+        if (*list == ',') list++;
+        else if (*list) return -1;
+    }
+
+    return 0;
+}
+
 static const char *const usages[] = {
     "gemuboy <ROM_PATH> [[--] args]",
     NULL,
@@ -27,10 +72,27 @@ int main(int argc, const char **argv) {
 
     const char *rom_path = NULL;
     int headless = 0;
+    int scanline = 0;
+    int frame_skip = 0;
+    int save = 0;
+    char *save_path = NULL;
+#ifdef GB_PROFILER
+    const char *profile_path = NULL;
+#endif
+    const char *breakpoints = NULL;
+    const char *watchpoints = NULL;
 
     struct argparse_option options[] = {
         OPT_HELP(),
         OPT_BOOLEAN('l', "headless", &headless, "Run without GUI (mainly for test automation)", NULL, 0, 0),
+        OPT_BOOLEAN('S', "save", &save, "Keep battery-backed RAM in the ROM's .sav file (locked while running)", NULL, 0, 0),
+        OPT_BOOLEAN('s', "scanline", &scanline, "Draw whole lines at once unless the game changes the PPU registers mid-line", NULL, 0, 0),
+        OPT_INTEGER('f', "frame-skip", &frame_skip, "Leave this many frames undrawn after each drawn one, timing stays exact", NULL, 0, 0),
+        OPT_STRING('b', "break", &breakpoints, "Report the registers before running these instructions ([bank:]addr,...)", NULL, 0, 0),
+        OPT_STRING('w', "watch", &watchpoints, "Report the registers after accessing these addresses (addr[:r|w],...)", NULL, 0, 0),
+#ifdef GB_PROFILER
+        OPT_STRING('p', "profile", &profile_path, "Write per-opcode counts and cycles to this CSV (or .json) file on exit", NULL, 0, 0),
+#endif
         OPT_END()
     };
 
@@ -43,12 +105,35 @@ int main(int argc, const char **argv) {
         exit(EXIT_FAILURE);
     }
 
-    gb = GB_gameboy_create(rom_path, headless);
+    if (save && !( save_path = GB_cartridge_save_path(rom_path) )) {
+        fprintf(stderr, "CANNOT CREATE SAVE PATH\n");
+        return EXIT_FAILURE;
+    }
+
+    gb = GB_gameboy_create(rom_path, save_path, headless);
+    free(save_path);
     if (!gb) {
         fprintf(stderr, "CANNOT CREATE GAMEBOY\n");
         return EXIT_FAILURE;
     }
 
+    gb->scanline_renderer = scanline;
+    gb->frame_skip        = frame_skip < 0 ? 0 : frame_skip;
+
+    if (breakpoints || watchpoints) {
+        gb->debugger = GB_debugger_create();
+        if (!gb->debugger ||
+            ( breakpoints && parse_breakpoints(gb, breakpoints) ) ||
+            ( watchpoints && parse_watchpoints(gb, watchpoints) )) {
+            fprintf(stderr, "INVALID BREAKPOINT OR WATCHPOINT LIST\n");
+            GB_gameboy_destroy(gb);
+            return EXIT_FAILURE;
+        }
+    }
+#ifdef GB_PROFILER
+    if (profile_path) gb->exec->profiler = GB_profiler_create();
+#endif
+
     while(isrunning) {
         SDL_Event event;
         while(!headless && SDL_PollEvent(&event)) {
@@ -60,13 +145,22 @@ int main(int argc, const char **argv) {
                     break;
             }
         }
+        GB_joypad_poll(gb);
 
 
         // Temporary solution to deal with PollEvent being slow
-        for (int i = 0; i < 1000; i++)
-            GB_cpu_run(gb);
+        GB_gameboy_run(gb, 1000);
+
+        // No interactive prompt yet: every hit is logged then execution goes on
+        if (GB_DEBUGGER_STOPPED(gb)) {
+            GB_debugger_report(gb->debugger, stderr);
+            GB_debugger_resume(gb->debugger);
+        }
     }
 
+#ifdef GB_PROFILER
+    if (profile_path && gb->exec->profiler) GB_profiler_export(gb->exec->profiler, profile_path);
+#endif
     GB_gameboy_destroy(gb);
 
     SDL_Quit();
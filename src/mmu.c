@@ -4,9 +4,12 @@
 #include "memmap.h"
 #include "joypad.h"
 #include "cartridge/mbc.h"
+#include "cpu/block_cache.h"
+#include "debugger.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 enum DMA_STATE {
 	DMA_STOP,
@@ -17,17 +20,37 @@ enum DMA_STATE {
 };
 
 #define DMA_RESTART_CNTDOWN_DEFAULT (3) // Waits 2 M-cycle and restart on the third one
-#define DMA_SOURCE_ADDR (0xFF46)
+#define DMA_SOURCE_ADDR (GB_DMA_ADDR)
+
+#define PAGE_COUNT          (0x100)
+#define PAGE(addr)          ( (addr) >> 8 )
+#define PAGE_OFFSET(addr)   ( (addr) & 0xFF )
+
+typedef BYTE (*page_read_handler)(GB_gameboy_t *gb, WORD addr);
+typedef void (*page_write_handler)(GB_gameboy_t *gb, WORD addr, BYTE data);
+
+typedef struct {
+	const BYTE 			*read;				// Base of the page when reads hit plain memory, NULL to use the handler
+	BYTE 				*write;				// Same for writes
+	page_read_handler 	read_handler;
+	page_write_handler 	write_handler;
+} GB_page_t;
+
+#define IO_REG_COUNT        ( GB_IO_REGS_END_ADDR - GB_IO_REGS_START_ADDR + 1 )
+#define IO_REG(addr)        ( (addr) & 0x7F )
+
+typedef struct {
+	page_read_handler 	read;
+	page_write_handler 	write;
+	BYTE 				unused;				// Bits reading as 1
+	BYTE 				read_only;			// Bits CPU writes leave alone
+} GB_io_reg_t;
 
 struct GB_mmu_s {
-	int dma_state;
-	int dma_offset;
-	int is_dma_active; // Whether dma is running regardless of its state
-	int dma_restart_cntdown;
-	WORD dma_source;
-
-	WORD addr_bus; // Used for DMA conflict
-	BYTE data_bus;
+	GB_page_t 	pages[PAGE_COUNT]; 			// 256-byte pages of the address space
+	GB_page_t 	mapped[PAGE_COUNT]; 		// What pages hold without watchpoints
+	BYTE 		watched[PAGE_COUNT]; 		// Pages going through the debugger
+	GB_io_reg_t io_regs[IO_REG_COUNT]; 		// FF00-FF7F, see GB_IO_REGS
 };
 
 #define _START_ADDR(area_name_upper_case)   (GB_ ## area_name_upper_case ## _START_ADDR) 
@@ -53,50 +76,141 @@ struct GB_mmu_s {
 #define MAKE_MEM_read_RANGE_ACCESS_CALLBACK(area_name_upper_case, prefix, user_data)        IF_ADDR_IN_RANGE ( area_name_upper_case, return prefix##_read(user_data, addr); )
 #define MAKE_MEM_write_ACCESS_CALLBACK(access_addr, prefix, user_data)                      IF_ADDR          ( access_addr, { prefix##_write(user_data, addr, data); return; } )
 #define MAKE_MEM_read_ACCESS_CALLBACK(access_addr, prefix, user_data)                       IF_ADDR          ( access_addr, return prefix##_read(user_data, addr); )
-#define MAKE_MEM_write_RANGE_ACCESS_ARRAY(area_name_upper_case, array_name)                 IF_ADDR_IN_RANGE ( area_name_upper_case, { ADJUST_ADDR(area_name_upper_case); gb->array_name[addr] = data; return; } ) 
-#define MAKE_MEM_read_RANGE_ACCESS_ARRAY(area_name_upper_case, array_name)                  IF_ADDR_IN_RANGE ( area_name_upper_case, { ADJUST_ADDR(area_name_upper_case); return gb->array_name[addr]; } )
-#define MAKE_MEM_write_ACCESS_VAR(access_addr, var_name)                                    IF_ADDR          ( access_addr, gb->var_name = data; return; )
-#define MAKE_MEM_read_ACCESS_VAR(access_addr, var_name)                                     IF_ADDR          ( access_addr, return gb->var_name; )
+#define MAKE_MEM_write_RANGE_ACCESS_ARRAY(area_name_upper_case, array_name)                 IF_ADDR_IN_RANGE ( area_name_upper_case, { ADJUST_ADDR(area_name_upper_case); gb->state.array_name[addr] = data; return; } ) 
+#define MAKE_MEM_read_RANGE_ACCESS_ARRAY(area_name_upper_case, array_name)                  IF_ADDR_IN_RANGE ( area_name_upper_case, { ADJUST_ADDR(area_name_upper_case); return gb->state.array_name[addr]; } )
+#define MAKE_MEM_write_ACCESS_VAR(access_addr, var_name)                                    IF_ADDR          ( access_addr, gb->state.var_name = data; return; )
+#define MAKE_MEM_read_ACCESS_VAR(access_addr, var_name)                                     IF_ADDR          ( access_addr, return gb->state.var_name; )
 
 #define _GB_io_reg_write(io_regs, addr, data)           ( io_regs[addr&0xFF] = data )
 #define _GB_io_reg_read(io_regs, addr)                  ( io_regs[addr&0xFF] )
 
 #define GB_timer_write(io_regs, addr, data)             _GB_io_reg_write(io_regs, addr, GB_timer_write_check(gb, addr, data))
-#define GB_timer_read(io_regs, addr)                    _GB_io_reg_read(io_regs, addr)
+#define GB_timer_read(io_regs, addr)                    ( GB_timer_sync(gb), _GB_io_reg_read(io_regs, addr) )
 
 #define GB_lcd_write(io_regs, addr, data) do {                                                                                                                      \
         if (addr == DMA_SOURCE_ADDR) {                                                                                                                              \
-            if (gb->mmu->dma_state == DMA_STOP) {                                                                                                                   \
-                gb->mmu->dma_state = DMA_START_M1;                                                                                                                  \
+            if (gb->state.dma.state == DMA_STOP) {                                                                                                                  \
+                gb->state.dma.state = DMA_START_M1;                                                                                                                 \
             } else {                                                                                                                                                \
-                gb->mmu->dma_restart_cntdown = DMA_RESTART_CNTDOWN_DEFAULT;                                                                                         \
+                gb->state.dma.restart_cntdown = DMA_RESTART_CNTDOWN_DEFAULT;                                                                                        \
             }                                                                                                                                                       \
+            GB_SCHEDULE_ASAP(gb, GB_EVENT_DMA);                                                                                                                     \
+        } else {                                                                                                                                                    \
+            GB_ppu_register_write(gb, addr, data);                                                                                                                  \
+            if (addr == GB_LCDC_ADDR) GB_SCHEDULE_ASAP(gb, GB_EVENT_PPU); /* The PPU sleeps while the LCD is off */                                                 \
         }                                                                                                                                                           \
         _GB_io_reg_write(io_regs, addr, data);                                                                                                                      \
 } while (0)
-#define GB_lcd_read(io_regs, addr) _GB_io_reg_read(io_regs, addr)
 
 #define GB_boot_rom_write(io_regs, addr, data) (io_regs[addr&0xFF] |= (data!=0))
-#define GB_boot_rom_read(io_regs, addr) _GB_io_reg_read(io_regs, addr) 
+
+/*=============== IO REGISTERS ===============*/
+
+BYTE io_plain_read(GB_gameboy_t *gb, WORD addr) {
+    return _GB_io_reg_read(gb->state.io_regs, addr);
+}
+
+void io_plain_write(GB_gameboy_t *gb, WORD addr, BYTE data) {
+    _GB_io_reg_write(gb->state.io_regs, addr, data);
+}
+
+void io_none_write(GB_gameboy_t *gb, WORD addr, BYTE data) {
+    (void)gb; (void)addr; (void)data;
+}
+
+BYTE io_joypad_read(GB_gameboy_t *gb, WORD addr) {
+    (void)addr; // P1 is the only joypad register
+    return GB_joypad_read(gb, addr);
+}
+
+void io_joypad_write(GB_gameboy_t *gb, WORD addr, BYTE data) {
+    (void)addr;
+    GB_joypad_write(gb, addr, data);
+}
+
+void io_serial_write(GB_gameboy_t *gb, WORD addr, BYTE data) {
+    // temporary solution until serial transfer is implemented
+    if (addr == GB_SC_ADDR && (data & 0x80) == 0x80) {
+        printf("%d", gb->state.io_regs[1]);
+        fflush(stdout);
+    }
+
+    _GB_io_reg_write(gb->state.io_regs, addr, data);
+}
+
+BYTE io_timer_read(GB_gameboy_t *gb, WORD addr) {
+    return GB_timer_read(gb->state.io_regs, addr);
+}
+
+void io_timer_write(GB_gameboy_t *gb, WORD addr, BYTE data) {
+    GB_timer_write(gb->state.io_regs, addr, data);
+}
+
+void io_lcd_write(GB_gameboy_t *gb, WORD addr, BYTE data) {
+    GB_lcd_write(gb->state.io_regs, addr, data);
+}
+
+void io_boot_rom_write(GB_gameboy_t *gb, WORD addr, BYTE data) {
+    GB_boot_rom_write(gb->state.io_regs, addr, data);
+}
+
+BYTE io_reg_read(GB_gameboy_t *gb, WORD addr) {
+    const GB_io_reg_t *reg = &gb->mmu->io_regs[IO_REG(addr)];
+
+    return reg->read(gb, addr) | reg->unused;
+}
+
+void io_reg_write(GB_gameboy_t *gb, WORD addr, BYTE data) {
+    const GB_io_reg_t *reg = &gb->mmu->io_regs[IO_REG(addr)];
+
+    reg->write(gb, addr, ( data & ~reg->read_only ) | ( gb->state.io_regs[IO_REG(addr)] & reg->read_only ));
+}
+
+#define MAP_IO_REGS(start, end, read_cb, write_cb) do {                                         \
+    for (int reg_addr = (start); reg_addr <= (end); reg_addr++) {                               \
+        mmu->io_regs[IO_REG(reg_addr)].read     = read_cb;                                      \
+        mmu->io_regs[IO_REG(reg_addr)].write    = write_cb;                                     \
+    }                                                                                           \
+} while(0)
+
+/* No trailing semicolon in GB_IO_REGS, hence a plain block */
+#define IO_REG_MASKS(addr, unused_bits, read_only_bits) {                                       \
+    MAP_IO_REGS(addr, addr, io_plain_read, io_plain_write);                                     \
+    mmu->io_regs[IO_REG(addr)].unused       = unused_bits;                                      \
+    mmu->io_regs[IO_REG(addr)].read_only    = read_only_bits;                                   \
+}
+
+/// Registers listed in memmap.h are plain memory with their masks until hooked to the components they drive
+void map_io_regs(GB_mmu_t *mmu) {
+    for (int i = 0; i < IO_REG_COUNT; i++) {
+        mmu->io_regs[i].unused      = 0xFF;
+        mmu->io_regs[i].read_only   = 0x00;
+    }
+
+    MAP_IO_REGS(GB_IO_REGS_START_ADDR,          GB_IO_REGS_END_ADDR,            io_plain_read,  io_none_write);
+
+    for (int addr = GB_WAVE_PATTERN_RAM_START_ADDR; addr <= GB_WAVE_PATTERN_RAM_END_ADDR; addr++) {
+        IO_REG_MASKS(addr, 0x00, 0x00)
+    }
+
+    GB_IO_REGS(IO_REG_MASKS)
+
+    MAP_IO_REGS(GB_JOYP_ADDR,                   GB_JOYP_ADDR,                   io_joypad_read, io_joypad_write);
+    MAP_IO_REGS(GB_SERIAL_START_ADDR,           GB_SERIAL_END_ADDR,             io_plain_read,  io_serial_write);
+    MAP_IO_REGS(GB_TIMER_REGS_START_ADDR,       GB_TIMER_REGS_END_ADDR,         io_timer_read,  io_timer_write);
+    MAP_IO_REGS(GB_LCD_REGS_START_ADDR,         GB_LCD_REGS_END_ADDR,           io_plain_read,  io_lcd_write);
+    MAP_IO_REGS(GB_BOOT_ROM_UNMAP_ADDR,         GB_BOOT_ROM_UNMAP_ADDR,         io_plain_read,  io_boot_rom_write);
+}
 
 #define DECL_MEM_ACCESSOR(access_type)                                                                                                                              \
     MEM_##access_type##_FUNC_DECL {                                                                                                                                 \
         MAKE_MEM_##access_type##_RANGE_ACCESS_CALLBACK(ROM,                     GB_mbc,                 gb->cartridge->mbc)     /* ROM bank     -- 0000-7FFF */     \
-        MAKE_MEM_##access_type##_RANGE_ACCESS_CALLBACK(VRAM,                    GB_ppu_vram,            gb->ppu)                /* VRAM         -- 8000-9FFF */     \
+        MAKE_MEM_##access_type##_RANGE_ACCESS_CALLBACK(VRAM,                    GB_ppu_vram,            &gb->state.ppu)         /* VRAM         -- 8000-9FFF */     \
         MAKE_MEM_##access_type##_RANGE_ACCESS_CALLBACK(EXT_RAM,                 GB_mbc,                 gb->cartridge->mbc)     /* RAM bank     -- A000-BFFF */     \
         MAKE_MEM_##access_type##_RANGE_ACCESS_ARRAY   (WRAM,                    wram)                                           /* WRAM         -- C000-DFFF */     \
-        MAKE_MEM_##access_type##_RANGE_ACCESS_CALLBACK(OAM,                     GB_ppu_oam,             gb->ppu)                /* OAM          -- FE00-FE9F */     \
+        MAKE_MEM_##access_type##_RANGE_ACCESS_CALLBACK(OAM,                     GB_ppu_oam,             &gb->state.ppu)         /* OAM          -- FE00-FE9F */     \
         MAKE_MEM_##access_type##_RANGE_ACCESS_ARRAY   (UNUSABLE,                unusable)                                       /* Not Usable   -- FEA0-FEFF */     \
-        /* ============= IO REGS ============= */                                                                                                                   \
-        MAKE_MEM_##access_type##_ACCESS_CALLBACK      (GB_JOYP_ADDR,            GB_joypad,              gb)                     /* Joypad       -- FF00      */     \
-        MAKE_MEM_##access_type##_RANGE_ACCESS_CALLBACK(SERIAL,                  _GB_io_reg,             gb->io_regs)            /* Serial       -- FF01-FF02 */     \
-        MAKE_MEM_##access_type##_RANGE_ACCESS_CALLBACK(TIMER_REGS,              GB_timer,               gb->io_regs)            /* Timer        -- FF04-FF07 */     \
-        MAKE_MEM_##access_type##_ACCESS_CALLBACK      (GB_IF_ADDR,              _GB_io_reg,             gb->io_regs)            /* Interrupts   -- FF0F      */     \
-        MAKE_MEM_##access_type##_RANGE_ACCESS_CALLBACK(APU,                     _GB_io_reg,             gb->io_regs)            /* Audio        -- FF10-FF26 */     \
-        MAKE_MEM_##access_type##_RANGE_ACCESS_CALLBACK(WAVE_PATTERN_RAM,        _GB_io_reg,             gb->io_regs)            /* Wave pattern -- FF30-FF3F */     \
-        MAKE_MEM_##access_type##_RANGE_ACCESS_CALLBACK(LCD_REGS,                GB_lcd,                 gb->io_regs)            /* LCD Control, -- FF40-FF4B */     \
-        MAKE_MEM_##access_type##_ACCESS_CALLBACK      (GB_BOOT_ROM_UNMAP_ADDR,  GB_boot_rom,            gb->io_regs)            /* Boot rom     -- FF50      */     \
-        /* =================================== */                                                                                                                   \
+        MAKE_MEM_##access_type##_RANGE_ACCESS_CALLBACK(IO_REGS,                 io_reg,                 gb)                     /* IO regs      -- FF00-FF7F */     \
         MAKE_MEM_##access_type##_RANGE_ACCESS_ARRAY   (HRAM,                    hram)                                           /* HRAM         -- FF80-FFFE */     \
         MAKE_MEM_##access_type##_ACCESS_VAR           (GB_IE_ADDR,              ie)                                             /* IE           -- FFFF      */     \
         /* Adjust address match wram address range in case echo ram is accessed */                                                                                  \
@@ -108,34 +222,157 @@ struct GB_mmu_s {
 DECL_MEM_ACCESSOR(read)
 DECL_MEM_ACCESSOR(write)
 
-BYTE GB_mem_read(GB_gameboy_t *gb, WORD addr) { 
-    if (gb->mmu->is_dma_active) {
+/*=============== PAGE HANDLERS ===============*/
+
+BYTE cartridge_page_read(GB_gameboy_t *gb, WORD addr) {
+    return GB_mbc_read(gb->cartridge->mbc, addr);
+}
+
+void map_cartridge_pages(GB_gameboy_t *gb);
+
+void cartridge_page_write(GB_gameboy_t *gb, WORD addr, BYTE data) {
+    GB_mbc_write(gb->cartridge->mbc, addr, data);
+
+    if (addr <= GB_ROM_END_ADDR) {
+        map_cartridge_pages(gb); // Bank switch
+    }
+}
+
+/// OAM and the unusable area: OAM is locked while DMA runs
+BYTE oam_page_read(GB_gameboy_t *gb, WORD addr) {
+    if (gb->state.dma.is_active) {
 		// TODO: DMA conflicts
 
-		if (addr >= GB_OAM_START_ADDR && addr <= GB_OAM_END_ADDR) {
+		if (addr <= GB_OAM_END_ADDR) {
 			return 0xFF;
         }
 	}
 
-    return mem_read(gb, addr); 
+    return mem_read(gb, addr);
 }
 
-void GB_mem_write(GB_gameboy_t *gb, WORD addr, BYTE data) {
-    if (gb->mmu->is_dma_active) {
-		if (addr >= GB_OAM_START_ADDR && addr <= GB_OAM_END_ADDR) {
+void oam_page_write(GB_gameboy_t *gb, WORD addr, BYTE data) {
+    if (gb->state.dma.is_active) {
+		if (addr <= GB_OAM_END_ADDR) {
 			return;
         }
 	}
-    
-    // temporary solution until serial transfer is implemented
-    if (addr == GB_SC_ADDR && (data & 0x80) == 0x80) {
-        printf("%d", gb->io_regs[1]);
-        fflush(stdout);
-    }
 
     mem_write(gb, addr, data);
 }
 
+/// IO registers through their table, HRAM and IE
+BYTE io_page_read(GB_gameboy_t *gb, WORD addr) {
+    if (addr <= GB_IO_REGS_END_ADDR) {
+        return io_reg_read(gb, addr);
+    }
+
+    return addr == GB_IE_ADDR ? gb->state.ie : gb->state.hram[addr - GB_HRAM_START_ADDR];
+}
+
+void io_page_write(GB_gameboy_t *gb, WORD addr, BYTE data) {
+    if (addr <= GB_IO_REGS_END_ADDR) {
+        io_reg_write(gb, addr, data);
+    } else if (addr == GB_IE_ADDR) {
+        gb->state.ie = data;
+    } else {
+        gb->state.hram[addr - GB_HRAM_START_ADDR] = data;
+    }
+}
+
+/// Watched pages forward to their mapping once the debugger saw the access
+BYTE watch_page_read(GB_gameboy_t *gb, WORD addr) {
+    const GB_page_t *page = &gb->mmu->mapped[PAGE(addr)];
+    BYTE data = page->read ? page->read[PAGE_OFFSET(addr)] : page->read_handler(gb, addr);
+
+    if (gb->debugger) GB_debugger_watch_hit(gb, addr, data, GB_WATCH_READ);
+
+    return data;
+}
+
+void watch_page_write(GB_gameboy_t *gb, WORD addr, BYTE data) {
+    const GB_page_t *page = &gb->mmu->mapped[PAGE(addr)];
+
+    if (gb->debugger) GB_debugger_watch_hit(gb, addr, data, GB_WATCH_WRITE);
+
+    if (page->write) {
+        page->write[PAGE_OFFSET(addr)] = data;
+    } else {
+        page->write_handler(gb, addr, data);
+    }
+}
+
+static void install_page(GB_mmu_t *mmu, int page) {
+    mmu->pages[page] = mmu->mapped[page];
+
+    if (mmu->watched[page]) {
+        mmu->pages[page].read           = NULL;
+        mmu->pages[page].write          = NULL;
+        mmu->pages[page].read_handler   = watch_page_read;
+        mmu->pages[page].write_handler  = watch_page_write;
+    }
+}
+
+void GB_mmu_watch_page(GB_gameboy_t *gb, WORD addr, int watched) {
+    gb->mmu->watched[PAGE(addr)] = (BYTE)( watched != 0 );
+    install_page(gb->mmu, PAGE(addr));
+}
+
+#define MAP_PAGES(start, end, read_base, write_base, read_cb, write_cb) do {                                                                                        \
+    const BYTE *r = (read_base); BYTE *w = (write_base);                                                                                                            \
+    for (int page = PAGE(start); page <= PAGE(end); page++) {                                                                                                       \
+        gb->mmu->mapped[page].read          = r ? r + ( (page - PAGE(start)) << 8 ) : NULL;                                                                         \
+        gb->mmu->mapped[page].write         = w ? w + ( (page - PAGE(start)) << 8 ) : NULL;                                                                         \
+        gb->mmu->mapped[page].read_handler  = read_cb;                                                                                                              \
+        gb->mmu->mapped[page].write_handler = write_cb;                                                                                                             \
+        install_page(gb->mmu, page);                                                                                                                                \
+    }                                                                                                                                                               \
+} while(0)
+
+/// Reads go straight to the banks currently mapped, writes always reach the MBC
+void map_cartridge_pages(GB_gameboy_t *gb) {
+    GB_mbc_t *mbc = gb->cartridge->mbc;
+
+    MAP_PAGES(0x0000,                   0x3FFF,                 GB_mbc_base(mbc, 0x0000),               NULL,   cartridge_page_read,    cartridge_page_write);
+    MAP_PAGES(0x4000,                   GB_ROM_END_ADDR,        GB_mbc_base(mbc, 0x4000),               NULL,   cartridge_page_read,    cartridge_page_write);
+    MAP_PAGES(GB_EXT_RAM_START_ADDR,    GB_EXT_RAM_END_ADDR,    GB_mbc_base(mbc, GB_EXT_RAM_START_ADDR),NULL,   cartridge_page_read,    cartridge_page_write);
+}
+
+void GB_mmu_map(GB_gameboy_t *gb) {
+    BYTE *tile_maps = gb->state.ppu.vram + (GB_TILE_MAPS_START_ADDR - GB_VRAM_START_ADDR);
+
+    map_cartridge_pages(gb);
+    MAP_PAGES(GB_TILE_DATA_START_ADDR,  GB_TILE_DATA_END_ADDR,  gb->state.ppu.vram, NULL,               mem_read,               mem_write); /* Writes decode the tile row */
+    MAP_PAGES(GB_TILE_MAPS_START_ADDR,  GB_TILE_MAPS_END_ADDR,  tile_maps,          tile_maps,          mem_read,               mem_write);
+    MAP_PAGES(GB_WRAM_START_ADDR,       GB_WRAM_END_ADDR,       gb->state.wram,     gb->state.wram,     mem_read,               mem_write);
+    MAP_PAGES(GB_ECHO_RAM_START_ADDR,   GB_ECHO_RAM_END_ADDR,   gb->state.wram,     gb->state.wram,     mem_read,               mem_write);
+    MAP_PAGES(GB_OAM_START_ADDR,        GB_UNUSABLE_END_ADDR,   NULL,               NULL,               oam_page_read,          oam_page_write);
+    MAP_PAGES(GB_JOYP_ADDR,             GB_IE_ADDR,             NULL,               NULL,               io_page_read,           io_page_write);
+}
+
+BYTE GB_mem_read(GB_gameboy_t *gb, WORD addr) { 
+    const GB_page_t *page = &gb->mmu->pages[PAGE(addr)];
+
+    if (page->read) {
+        return page->read[PAGE_OFFSET(addr)];
+    }
+
+    return page->read_handler(gb, addr);
+}
+
+void GB_mem_write(GB_gameboy_t *gb, WORD addr, BYTE data) {
+    const GB_page_t *page = &gb->mmu->pages[PAGE(addr)];
+
+    GB_block_cache_write_notify(gb, addr);
+
+    if (page->write) {
+        page->write[PAGE_OFFSET(addr)] = data;
+        return;
+    }
+
+    page->write_handler(gb, addr, data);
+}
+
 GB_mmu_t* GB_mmu_create() {
 	GB_mmu_t *mmu = (GB_mmu_t*)( malloc( sizeof (GB_mmu_t) ) );
 
@@ -143,48 +380,123 @@ GB_mmu_t* GB_mmu_create() {
 		return NULL;
 	}
 
-	mmu->dma_state 	= DMA_STOP;
-	mmu->dma_offset = 0;
-	mmu->dma_restart_cntdown = 0;
-    mmu->is_dma_active = 0;
+	for (int i = 0; i < PAGE_COUNT; i++) {
+		mmu->mapped[i].read          = NULL;
+		mmu->mapped[i].write         = NULL;
+		mmu->mapped[i].read_handler  = mem_read;
+		mmu->mapped[i].write_handler = mem_write;
+		mmu->watched[i]              = 0;
+		install_page(mmu, i);
+	}
+
+	map_io_regs(mmu);
 
 	return mmu;
 }
 
+void GB_dma_init(GB_dma_t *dma) {
+	dma->state              = DMA_STOP;
+	dma->offset             = 0;
+	dma->restart_cntdown    = 0;
+	dma->is_active          = 0;
+	dma->source             = 0;
+	dma->is_bulk            = 0;
+	dma->bulk_start         = 0;
+	dma->addr_bus           = 0;
+	dma->data_bus           = 0;
+}
+
 void GB_mmu_destroy(GB_mmu_t *mmu) {
 	if (mmu) free(mmu);
 }
 
+/// Copies the transfer up to byte end (excluded), in one go when the source page is plain memory
+static void dma_copy(GB_gameboy_t *gb, int end) {
+	GB_dma_t *dma = &gb->state.dma;
+	const GB_page_t *page = &gb->mmu->pages[PAGE(dma->source)];
+	BYTE *oam = gb->state.ppu.oam;
+
+	if (end <= dma->offset) return;
+
+	if (page->read) {
+		memcpy(oam + dma->offset, page->read + dma->offset, end - dma->offset);
+	} else {
+		for (int i = dma->offset; i < end; i++) {
+			oam[i] = mem_read(gb, dma->source | i);
+		}
+	}
+
+	dma->offset 	= end;
+	dma->addr_bus 	= GB_OAM_START_ADDR | (end - 1);
+	dma->data_bus 	= oam[end - 1];
+}
+
+/**
+ * Nothing can tell a transfer copied at once from one stepped byte by byte as long as the PPU keeps off OAM,
+ * the source is plain memory, which only the CPU writes, and no restart is pending.
+ * CPU writes outside HRAM call GB_dma_sync first
+*/
+static int dma_bulk_possible(GB_gameboy_t *gb) {
+	GB_dma_t *dma = &gb->state.dma;
+
+	return !dma->restart_cntdown && dma->source < GB_OAM_START_ADDR && GB_ppu_oam_idle(gb, GB_DMA_LENGTH);
+}
+
 void GB_dma_run(GB_gameboy_t *gb) {
-	if (gb->mmu->dma_restart_cntdown && gb->mmu->dma_restart_cntdown-- == 1) {
-		gb->mmu->dma_state = DMA_INIT;
+	GB_dma_t *dma = &gb->state.dma;
+
+	if (dma->restart_cntdown && dma->restart_cntdown-- == 1) {
+		dma->state = DMA_INIT;
 	}
 
-	switch (gb->mmu->dma_state) { 									
+	switch (dma->state) { 									
     	case DMA_START_M1: 											
-			gb->mmu->dma_state = DMA_START_M2;
+			dma->state = DMA_START_M2;
 			break;
     	case DMA_START_M2: 											
-    		gb->mmu->dma_state = DMA_INIT; 						
+    		dma->state = DMA_INIT; 						
     		break; 													
 		case DMA_INIT:
-			gb->mmu->dma_source     = ( mem_read(gb, DMA_SOURCE_ADDR) << 8 );
-    		gb->mmu->dma_state 		= DMA_RUNNING; 						
-			gb->mmu->is_dma_active 	= 1;
-			gb->mmu->dma_offset 	= 0;
+			dma->source = ( mem_read(gb, DMA_SOURCE_ADDR) << 8 );
+    		dma->state = DMA_RUNNING; 						
+			dma->is_active = 1;
+			dma->offset = 0;
+
+			if (dma_bulk_possible(gb)) {
+				dma->is_bulk    = 1;
+				dma->bulk_start = gb->state.cpu.t_cycle_counter;
+				GB_SCHEDULE_IN(gb, GB_EVENT_DMA, GB_DMA_LENGTH - 1); // M-cycle of the last byte
+				return;
+			}
 			// NOTE: break is omitted on purpose
     	case DMA_RUNNING: {
-			gb->mmu->addr_bus = GB_OAM_START_ADDR | gb->mmu->dma_offset;
-            gb->mmu->data_bus = mem_read(gb, (gb->mmu->dma_source | gb->mmu->dma_offset));
-    		mem_write(gb, gb->mmu->addr_bus, gb->mmu->data_bus);
-    		if (++gb->mmu->dma_offset > ( GB_OAM_END_ADDR & 0xFF ) ) { 	
-    			gb->mmu->dma_state 		= DMA_STOP; 						
-				gb->mmu->dma_offset 	= 0;
-				gb->mmu->is_dma_active 	= 0;
+			dma_copy(gb, dma->is_bulk ? GB_DMA_LENGTH : dma->offset + 1);
+    		if (dma->offset >= GB_DMA_LENGTH) { 	
+    			dma->state = DMA_STOP; 						
+				dma->offset = 0;
+				dma->is_active = 0;
+				dma->is_bulk = 0;
     		} 			
 		}
     		break;												
     	default: 													
     		break; 													
     } 																
+
+	if (dma->state != DMA_STOP || dma->restart_cntdown) {
+		GB_SCHEDULE_IN(gb, GB_EVENT_DMA, 1);
+	} else {
+		GB_UNSCHEDULE(gb, GB_EVENT_DMA);
+	}
+}
+
+void GB_dma_sync(GB_gameboy_t *gb) {
+	GB_dma_t *dma = &gb->state.dma;
+
+	if (!dma->is_bulk) return;
+
+	// Byte n is copied on the M-cycle ending at bulk_start + 4n, before anything else runs on it
+	dma_copy(gb, (int)( ( gb->state.cpu.t_cycle_counter - dma->bulk_start ) / 4 ) + 1);
+	dma->is_bulk = 0;
+	GB_SCHEDULE_IN(gb, GB_EVENT_DMA, 1);
 }
@@ -1,7 +1,7 @@
 #!/bin/bash
 
 SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
-USAGE_MGS="USAGE: testboy.sh <ROM_PATH> <TEST_SUITE_ID> [GEMUBOY_PATH]"
+USAGE_MGS="USAGE: testboy.sh <ROM_PATH> <TEST_SUITE_ID> [GEMUBOY_PATH] [GEMUBOY_FLAGS...]"
 
 GEKKIO_SUCCESS_SEQ="358132134"
 GEKKIO_FAILURE_SEQ="666666666666"
@@ -9,6 +9,7 @@ GEKKIO_FAILURE_SEQ="666666666666"
 rom_path=$1
 test_suite_id=$2
 gemuboy_path=$3
+gemuboy_flags=("${@:4}")
 success_seq=""
 failure_seq=""
 
@@ -33,7 +34,7 @@ esac
 res=""
 exit_code=2
 
-exec 3< <(timeout --preserve-status 60 $gemuboy_path $rom_path -l)
+exec 3< <(timeout --preserve-status 60 $gemuboy_path $rom_path -l "${gemuboy_flags[@]}")
 
 while IFS= read -n1 c; do
     res+="$c"